@@ -0,0 +1,169 @@
+#include "BarrettContext.h"
+#include "BlockArithmetic.h"
+
+using namespace BlockArithmetic;
+
+namespace {
+
+/* Short schoolbook products for moduli in the schoolbook range, where
+ * skipping half the partial products pays. Karatsuba and up compute the
+ * full product instead.
+ */
+inline bool useShortProducts(BarrettContext::Index k) {
+    return k < 2 * BigUnsigned::karatsubaThreshold;
+}
+
+/* r = a * b except that the partial products below block "from" are left
+ * out, together with their carries; r has an + bn blocks */
+void multiplyHigh(Blk *r, const Blk *a, Index an, const Blk *b, Index bn,
+        Index from) {
+    zeroBlocks(r, bn);
+    for (Index i = 0; i < an; ++i) {
+        Index j = (i < from) ? from - i : 0;
+        r[i + bn] = (j < bn) ? addMulBlock(r + i + j, b + j, bn - j, a[i]) : 0;
+    }
+}
+
+/* r[0, n) = a * b mod B^n */
+void multiplyLow(Blk *r, const Blk *a, Index an, const Blk *b, Index bn,
+        Index n) {
+    zeroBlocks(r, n);
+    for (Index i = 0; i < an && i < n; ++i) {
+        Index l = (bn < n - i) ? bn : n - i;
+        Blk carry = addMulBlock(r + i, b, l, a[i]);
+        if (i + l < n)
+            addBlock(r + i + l, r + i + l, n - i - l, carry);
+    }
+}
+
+/* The most scratch that multiplyBlocks takes for the product of k blocks
+ * with any number of blocks from 1 to n. multiplyScratchSize is not
+ * monotone in the shorter length, so every length is tried.
+ */
+Index productScratchSize(Index k, Index n) {
+    Index size = 0;
+    for (Index i = 1; i <= n; ++i) {
+        Index s = (i >= k) ? multiplyScratchSize(i, k)
+                : multiplyScratchSize(k, i);
+        if (s > size)
+            size = s;
+    }
+    return size;
+}
+
+}
+
+BarrettContext::BarrettContext(const BigUnsigned &modulus)
+        : m(modulus), k(modulus.len) {
+    if (m.isZero())
+        throw "BarrettContext::BarrettContext: modulus is zero";
+    // mu = floor(B^2k / m), which has k + 1 blocks, or k + 2 when m is a
+    // power of B
+    NumberlikeArray<Blk> b2k(2 * k + 1);
+    zeroBlocks(b2k.blk, 2 * k);
+    b2k.blk[2 * k] = 1;
+    BigUnsigned r(b2k.blk, 2 * k + 1);
+    r.divideWithRemainder(m, mu);
+    // q3 has at most q2n - (k + 1) <= (k + 1) + mu.len - (k + 1) blocks
+    // for the longest x, of 2k blocks
+    productScratch = productScratchSize(k, mu.len);
+}
+
+/* Scratch layout: the remainder (k + 1 blocks), q1 mu (up to 2k + 3), the
+ * low blocks of q3 m (up to 2k + 2), and the multiplications' own scratch.
+ * The estimate q3 = floor(floor(x / B^(k-1)) mu / B^(k+1)) is at most 2
+ * short of floor(x / m), so r = x - q3 m is below 3m and only its low k + 1
+ * blocks need to be computed. Leaving out the partial products of q1 mu
+ * below block k - 1 changes q2 by less than k B^k, which costs at most one
+ * more subtraction of m at the end (HAC 14.44).
+ */
+void BarrettContext::reduceBlocks(Blk *r, const Blk *x, Index xn) {
+    if (xn < k) {
+        // x < B^(k-1) <= m already
+        copyBlocks(r, x, xn);
+        zeroBlocks(r + xn, k - xn);
+        return;
+    }
+    const Blk *q1 = x + (k - 1);
+    Index q1n = xn - (k - 1), mun = mu.len;
+    Index q2n = q1n + mun;
+    Index big = (q1n > mun) ? q1n : mun, small = q1n + mun - big;
+    bool shortProducts = useShortProducts(k);
+    // The q3 m product below takes m with q3 trimmed of leading zeros, so
+    // with anything up to q2n - (k + 1) blocks; productScratch covers them
+    Index s1 = shortProducts ? 0 : multiplyScratchSize(big, small);
+    Index s2 = shortProducts ? 0 : productScratch;
+    Index size = (k + 1) + q2n + (2 * k + 1) + ((s1 > s2) ? s1 : s2);
+    ws.allocate(size);
+    Blk *rr = ws.blk, *q2 = rr + (k + 1), *p = q2 + q2n, *mws = p + 2 * k + 1;
+
+    if (shortProducts)
+        multiplyHigh(q2, q1, q1n, mu.blk, mun, k - 1);
+    else if (q1n >= mun)
+        multiplyBlocks(q2, q1, q1n, mu.blk, mun, mws);
+    else
+        multiplyBlocks(q2, mu.blk, mun, q1, q1n, mws);
+
+    // r = (x - q3 m) mod B^(k+1)
+    Index xl = (xn < k + 1) ? xn : k + 1;
+    copyBlocks(rr, x, xl);
+    zeroBlocks(rr + xl, (k + 1) - xl);
+    if (q2n > k + 1) {
+        const Blk *q3 = q2 + (k + 1);
+        Index q3n = q2n - (k + 1);
+        while (q3n > 0 && q3[q3n - 1] == 0)
+            --q3n;
+        if (q3n > 0) {
+            if (shortProducts)
+                multiplyLow(p, q3, q3n, m.blk, k, k + 1);
+            else if (q3n >= k)
+                multiplyBlocks(p, q3, q3n, m.blk, k, mws);
+            else
+                multiplyBlocks(p, m.blk, k, q3, q3n, mws);
+            subBlocks(rr, rr, p, k + 1);
+        }
+    }
+    while (rr[k] != 0 || compareBlocks(rr, m.blk, k) >= 0) {
+        Blk borrow = subBlocks(rr, rr, m.blk, k);
+        rr[k] -= borrow;
+    }
+    copyBlocks(r, rr, k);
+}
+
+void BarrettContext::reduce(BigUnsigned &r, const BigUnsigned &x) {
+    if (x.len > 2 * k) {
+        BigUnsigned q;
+        r = x;
+        r.divideWithRemainder(m, q);
+        return;
+    }
+    // The result is computed in scratch space, so r may be x
+    if (&r == &x)
+        r.allocateAndCopy(k);
+    else
+        r.allocate(k);
+    reduceBlocks(r.blk, x.blk, x.len);
+    r.len = k;
+    r.zapLeadingZeros();
+}
+
+void BarrettContext::mulMod(BigUnsigned &r, const BigUnsigned &a,
+        const BigUnsigned &b) {
+    if (a.len > k || b.len > k)
+        throw "BarrettContext::mulMod: operands must be less than the modulus";
+    if (a.isZero() || b.isZero()) {
+        r.len = 0;
+        return;
+    }
+    const BigUnsigned &a2 = (a.len >= b.len) ? a : b;
+    const BigUnsigned &b2 = (a.len >= b.len) ? b : a;
+    Index pn = a2.len + b2.len;
+    // The product goes in its own buffer, since reduceBlocks uses ws
+    product.allocate(pn + multiplyScratchSize(a2.len, b2.len));
+    multiplyBlocks(product.blk, a2.blk, a2.len, b2.blk, b2.len,
+            product.blk + pn);
+    r.allocate(k);
+    reduceBlocks(r.blk, product.blk, pn);
+    r.len = k;
+    r.zapLeadingZeros();
+}
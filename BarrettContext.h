@@ -0,0 +1,70 @@
+#ifndef BARRETTCONTEXT_H
+#define BARRETTCONTEXT_H
+
+#include "BigUnsigned.h"
+
+/* A BarrettContext reduces values modulo one fixed nonzero modulus m of k
+ * blocks without dividing. It precomputes mu = floor(B^2k / m) once, where B
+ * is the block base, after which each reduction of a value below B^2k costs
+ * two multiplications and at most two subtractions (Barrett's method, as in
+ * the Handbook of Applied Cryptography, 14.42).
+ *
+ * A context keeps its own scratch space, so after the first few calls it
+ * allocates nothing, provided the results go into BigUnsigneds that already
+ * have room for k blocks. For the same reason, one context must not be used
+ * by two threads at once; build one per thread, or cache them per key.
+ */
+class BarrettContext {
+
+    public:
+        typedef BigUnsigned::Blk   Blk;
+        typedef BigUnsigned::Index Index;
+
+        /* Throws an exception if m is zero */
+        BarrettContext(const BigUnsigned &modulus);
+
+        const BigUnsigned &getModulus() const { return m; }
+
+        // COPY-LESS OPERATIONS
+
+        /* r = x mod m. Values of 2k blocks or fewer, such as anything below
+         * m^2, take the fast path; longer ones fall back to long division.
+         * r may be x.
+         */
+        void reduce(BigUnsigned &r, const BigUnsigned &x);
+
+        /* r = a * b mod m, where a and b have at most k blocks (anything
+         * below m qualifies). r may be a or b.
+         */
+        void mulMod(BigUnsigned &r, const BigUnsigned &a, const BigUnsigned &b);
+
+        // RETURN-BY-VALUE VERSIONS
+        BigUnsigned reduce(const BigUnsigned &x) {
+            BigUnsigned r;
+            reduce(r, x);
+            return r;
+        }
+        BigUnsigned mulMod(const BigUnsigned &a, const BigUnsigned &b) {
+            BigUnsigned r;
+            mulMod(r, a, b);
+            return r;
+        }
+
+    private:
+        BigUnsigned m;
+        BigUnsigned mu;
+        Index k;
+        // The most scratch multiplyBlocks takes for m times any q3 that
+        // reduceBlocks can meet, under the thresholds in force when the
+        // context was made
+        Index productScratch;
+        // Scratch space, grown as needed and then reused: ws for the
+        // reduction, product for mulMod's product and its scratch
+        NumberlikeArray<Blk> ws;
+        NumberlikeArray<Blk> product;
+
+        /* Reduces the xn <= 2k blocks at x into r, which has room for k */
+        void reduceBlocks(Blk *r, const Blk *x, Index xn);
+};
+
+#endif
@@ -1,10 +1,24 @@
 #include "BigUnsigned.h"
+#include "BlockArithmetic.h"
 
 // Memory management definitions are at the bottom of NumberlikeArray.hh
 
 // The templates used by these constructors and converters are at the bottom 
 // of BigUnsigned.hh
 
+// Crossover points, measured on x86-64 with 64-bit blocks
+BigUnsigned::Index BigUnsigned::karatsubaThreshold       = 24;
+BigUnsigned::Index BigUnsigned::karatsubaSquareThreshold = 32;
+BigUnsigned::Index BigUnsigned::toom3Threshold           = 250;
+BigUnsigned::Index BigUnsigned::toom4Threshold           = 600;
+BigUnsigned::Index BigUnsigned::nttThreshold             = 12000;
+BigUnsigned::Index BigUnsigned::burnikelZieglerThreshold = 40;
+BigUnsigned::Index BigUnsigned::newtonThreshold          = 40000;
+BigUnsigned::Index BigUnsigned::lehmerThreshold          = 4;
+BigUnsigned::Index BigUnsigned::halfGcdThreshold         = 800;
+BigUnsigned::Index BigUnsigned::jacobiLehmerThreshold    = 12;
+BigUnsigned::Index BigUnsigned::binaryInverseThreshold   = 8;
+
 BigUnsigned::BigUnsigned(unsigned long  x) { initFromPrimitive      (x); }
 BigUnsigned::BigUnsigned(unsigned int   x) { initFromPrimitive      (x); }
 BigUnsigned::BigUnsigned(unsigned short x) { initFromPrimitive      (x); }
@@ -169,3 +183,186 @@ void BigUnsigned::subtract(const BigUnsigned &a, const BigUnsigned &b) {
     // Zap leading zeros
     zapLeadingZeros();
 }
+
+void BigUnsigned::multiply(const BigUnsigned &a, const BigUnsigned &b) {
+    // Squares have their own, faster algorithms
+    if (&a == &b) {
+        square(a);
+        return;
+    }
+    // If either factor is zero, so is the product
+    if (a.len == 0 || b.len == 0) {
+        len = 0;
+        return;
+    }
+    // a2 points to the longer input, b2 points to the shorter
+    const BigUnsigned *a2, *b2;
+    if (a.len >= b.len) {
+        a2 = &a;
+        b2 = &b;
+    } else {
+        a2 = &b;
+        b2 = &a;
+    }
+    Index plen = a.len + b.len;
+    NumberlikeArray<Blk> ws(
+            BlockArithmetic::multiplyScratchSize(a2->len, b2->len));
+    if (this == &a || this == &b) {
+        // Aliased call: build the product in a fresh array and adopt it,
+        // which saves the copy DTRT_ALIASED would make
+        Blk *prod = new Blk[plen];
+        BlockArithmetic::multiplyBlocks(prod, a2->blk, a2->len,
+                b2->blk, b2->len, ws.blk);
+        delete [] blk;
+        blk = prod;
+        cap = plen;
+    } else {
+        allocate(plen);
+        BlockArithmetic::multiplyBlocks(blk, a2->blk, a2->len,
+                b2->blk, b2->len, ws.blk);
+    }
+    len = plen;
+    zapLeadingZeros();
+}
+
+void BigUnsigned::square(const BigUnsigned &a) {
+    if (a.len == 0) {
+        len = 0;
+        return;
+    }
+    Index plen = 2 * a.len;
+    NumberlikeArray<Blk> ws(BlockArithmetic::squareScratchSize(a.len));
+    if (this == &a) {
+        // Aliased call, handled as in multiply
+        Blk *prod = new Blk[plen];
+        BlockArithmetic::squareBlocks(prod, a.blk, a.len, ws.blk);
+        delete [] blk;
+        blk = prod;
+        cap = plen;
+    } else {
+        allocate(plen);
+        BlockArithmetic::squareBlocks(blk, a.blk, a.len, ws.blk);
+    }
+    len = plen;
+    zapLeadingZeros();
+}
+
+void BigUnsigned::divideWithRemainder(const BigUnsigned &b, BigUnsigned &q) {
+    // The remainder is left in *this, so the quotient needs its own variable
+    if (this == &q)
+        throw "BigUnsigned::divideWithRemainder: "
+            "Cannot write quotient and remainder into the same variable";
+    // The divisor is read after *this and q start changing; if it is one of
+    // them, work from a copy
+    if (this == &b || &q == &b) {
+        BigUnsigned tmpB(b);
+        divideWithRemainder(tmpB, q);
+        return;
+    }
+    // Division by zero gives a zero quotient and leaves *this alone, as does
+    // a divisor longer than *this
+    if (b.len == 0 || len < b.len) {
+        q.len = 0;
+        return;
+    }
+
+    // A one-block divisor needs no normalized copy
+    if (b.len == 1) {
+        q.allocate(len);
+        Blk r = BlockArithmetic::divideBlocksByBlock(q.blk, blk, len, b.blk[0]);
+        q.len = len;
+        q.zapLeadingZeros();
+        blk[0] = r;
+        len = 1;
+        zapLeadingZeros();
+        return;
+    }
+
+    // Normalize: shift both operands left until the divisor's top bit is
+    // set. The dividend shifts in place and gains one block at the top.
+    Index n = b.len, m = len - n;
+    unsigned int shift = BlockArithmetic::countLeadingZeros(b.blk[n - 1]);
+    NumberlikeArray<Blk> d(n);
+    allocateAndCopy(len + 1);
+    if (shift == 0) {
+        BlockArithmetic::copyBlocks(d.blk, b.blk, n);
+        blk[len] = 0;
+    } else {
+        BlockArithmetic::shiftLeftBlocks(d.blk, b.blk, n, shift);
+        blk[len] = BlockArithmetic::shiftLeftBlocks(blk, blk, len, shift);
+    }
+
+    q.allocate(m + 1);
+    BlockArithmetic::divideBlocks(q.blk, blk, len, d.blk, n);
+    q.len = m + 1;
+    q.zapLeadingZeros();
+
+    // The remainder is in the low n blocks, still shifted
+    if (shift != 0)
+        BlockArithmetic::shiftRightBlocks(blk, blk, n, shift);
+    len = n;
+    zapLeadingZeros();
+}
+
+BigUnsigned::Blk BigUnsigned::divideBySmall(Blk d) {
+    if (d == 0)
+        throw "BigUnsigned::divideBySmall: division by zero";
+    if (len == 0)
+        return 0;
+    Blk r = BlockArithmetic::divideBlocksByBlock(blk, blk, len, d);
+    zapLeadingZeros();
+    return r;
+}
+
+BigUnsigned::Blk BigUnsigned::remainderBySmall(Blk d) const {
+    if (d == 0)
+        throw "BigUnsigned::remainderBySmall: division by zero";
+    if (len == 0)
+        return 0;
+    return BlockArithmetic::remainderBlocksByBlock(blk, len, d);
+}
+
+BigUnsigned::Index BigUnsigned::bitLength() const {
+    if (len == 0)
+        return 0;
+    return len * N - BlockArithmetic::countLeadingZeros(blk[len - 1]);
+}
+
+void BigUnsigned::bitShiftLeft(const BigUnsigned &a, Index b) {
+    DTRT_ALIASED(this == &a, bitShiftLeft(a, b));
+    if (a.len == 0) {
+        len = 0;
+        return;
+    }
+    // Whole blocks of zeros, then the blocks of a shifted by what is left
+    Index kb = b / N;
+    unsigned int s = b % N;
+    allocate(a.len + kb + 1);
+    BlockArithmetic::zeroBlocks(blk, kb);
+    if (s == 0) {
+        BlockArithmetic::copyBlocks(blk + kb, a.blk, a.len);
+        blk[a.len + kb] = 0;
+    } else
+        blk[a.len + kb] = BlockArithmetic::shiftLeftBlocks(blk + kb, a.blk,
+                a.len, s);
+    len = a.len + kb + 1;
+    zapLeadingZeros();
+}
+
+void BigUnsigned::bitShiftRight(const BigUnsigned &a, Index b) {
+    DTRT_ALIASED(this == &a, bitShiftRight(a, b));
+    Index kb = b / N;
+    if (kb >= a.len) {
+        len = 0;
+        return;
+    }
+    Index n = a.len - kb;
+    unsigned int s = b % N;
+    allocate(n);
+    if (s == 0)
+        BlockArithmetic::copyBlocks(blk, a.blk + kb, n);
+    else
+        BlockArithmetic::shiftRightBlocks(blk, a.blk + kb, n, s);
+    len = n;
+    zapLeadingZeros();
+}
@@ -22,7 +22,51 @@ class BigUnsigned : protected NumberlikeArray<unsigned long>
         typedef NumberlikeArray<Blk>::Index Index;
         using NumberlikeArray<Blk>::N;
 
+        /* Multiplication crossover points, in blocks of the shorter operand.
+         * They are tunable at run time; see BlockMultiply.cpp.
+         */
+        // Operands this long use Karatsuba instead of the schoolbook method
+        static Index karatsubaThreshold;
+        // ... likewise for squaring, whose schoolbook method is faster
+        static Index karatsubaSquareThreshold;
+        // ... Toom-3 instead of Karatsuba
+        static Index toom3Threshold;
+        // ... Toom-4 instead of Toom-3
+        static Index toom4Threshold;
+        // ... the number-theoretic transform (64-bit blocks only)
+        static Index nttThreshold;
+        /* Division crossover points, in blocks of the divisor and of the
+         * quotient; see BlockDivide.cpp.
+         */
+        // Both this long use Burnikel-Ziegler instead of Knuth's method
+        static Index burnikelZieglerThreshold;
+        // ... a Newton-iterated reciprocal instead of Burnikel-Ziegler
+        static Index newtonThreshold;
+        /* GCD crossover points, in blocks of the smaller operand; see
+         * BlockGcd.cpp and BigUnsignedAlgorithms.cpp.
+         */
+        // Operands this long use Lehmer's method instead of the binary one
+        static Index lehmerThreshold;
+        // ... the half-gcd instead of Lehmer's method
+        static Index halfGcdThreshold;
+        // ... and for the Jacobi symbol, Lehmer's method instead of the
+        // binary one
+        static Index jacobiLehmerThreshold;
+        // Odd moduli this long are inverted through extendedGcd instead of
+        // the extended binary algorithm
+        static Index binaryInverseThreshold;
+
     protected:
+        // Reduction contexts work on the blocks directly
+        friend class BarrettContext;
+        friend class MontgomeryContext;
+        // ... as do the gcd algorithms
+        friend BigUnsigned gcd(const BigUnsigned &a, const BigUnsigned &b);
+        friend BigUnsigned modInverse(const BigUnsigned &a,
+                const BigUnsigned &m);
+        friend int jacobi(const BigUnsigned &a, const BigUnsigned &n);
+        friend class HalfGcd;
+
         /* Create a BigUnsigned with a capacity; for internal use */
         BigUnsigned(int, Index c) : NumberlikeArray<Blk>(0, c) {}
 
@@ -106,10 +150,12 @@ class BigUnsigned : protected NumberlikeArray<unsigned long>
 
         // COPY-LESS OPERATIONS
 
-        // These 8: Arguments are read-only operands, result is saved in *this
+        // These 9: Arguments are read-only operands, result is saved in *this
         void add     (const BigUnsigned &a, const BigUnsigned &b);
         void subtract(const BigUnsigned &a, const BigUnsigned &b);
         void multiply(const BigUnsigned &a, const BigUnsigned &b);
+        // Like multiply(a, a), which calls it, but spelled out
+        void square  (const BigUnsigned &a);
 
         /* "divide" and "modulo" are no longer offered. Use "divideWithRemainder"
          * instead;
@@ -119,12 +165,35 @@ class BigUnsigned : protected NumberlikeArray<unsigned long>
          */
         void divideWithRemainder(const BigUnsigned &b, BigUnsigned &q);
 
+        /* Division by a single block, which avoids long division entirely.
+         * "a.divideBySmall(d)" is like "r = a % d, a /= d; return r";
+         * "a.remainderBySmall(d)" returns a % d and leaves a alone. Both
+         * throw an exception if d is zero.
+         */
+        Blk divideBySmall(Blk d);
+        Blk remainderBySmall(Blk d) const;
+
+        /* Bit operations. bitLength() counts the bits up to and including
+         * the top set one, so it is 0 for zero. getBit(i) is bit i, counting
+         * from the least significant, and false past the top.
+         * "a.bitShiftLeft(x, b)" is like "a = x * 2^b", and
+         * "a.bitShiftRight(x, b)" like "a = x / 2^b".
+         */
+        Index bitLength() const;
+        bool getBit(Index i) const {
+            return i / N < len && ((blk[i / N] >> (i % N)) & 1) != 0;
+        }
+        void bitShiftLeft (const BigUnsigned &a, Index b);
+        void bitShiftRight(const BigUnsigned &a, Index b);
+
         // OVERLOAD RETURN-BY-VALUE OPERATORS
         BigUnsigned operator+(const BigUnsigned &x) const;
         BigUnsigned operator-(const BigUnsigned &x) const;
         BigUnsigned operator*(const BigUnsigned &x) const;
         BigUnsigned operator/(const BigUnsigned &x) const;
         BigUnsigned operator%(const BigUnsigned &x) const;
+        BigUnsigned operator<<(Index b) const;
+        BigUnsigned operator>>(Index b) const;
 
         // OVERLOAD ASSIGNMENT OPERATORS
         void operator+=(const BigUnsigned &x);
@@ -132,6 +201,8 @@ class BigUnsigned : protected NumberlikeArray<unsigned long>
         void operator*=(const BigUnsigned &x);
         void operator/=(const BigUnsigned &x);
         void operator%=(const BigUnsigned &x);
+        void operator<<=(Index b);
+        void operator>>=(Index b);
 
         // INCREMENT / DECREMENT OPERATORS
         void operator++(   );
@@ -173,6 +244,16 @@ inline BigUnsigned BigUnsigned::operator%(const BigUnsigned &x) const {
     r.divideWithRemainder(x, q);
     return r;
 }
+inline BigUnsigned BigUnsigned::operator<<(Index b) const {
+    BigUnsigned ans;
+    ans.bitShiftLeft(*this, b);
+    return ans;
+}
+inline BigUnsigned BigUnsigned::operator>>(Index b) const {
+    BigUnsigned ans;
+    ans.bitShiftRight(*this, b);
+    return ans;
+}
 
 inline void BigUnsigned::operator+=(const BigUnsigned &x) {
     add(*this, x);
@@ -196,6 +277,12 @@ inline void BigUnsigned::operator%=(const BigUnsigned &x) {
     // Mods *this by x, don't care about quotient left in q
     divideWithRemainder(x, q);
 }
+inline void BigUnsigned::operator<<=(Index b) {
+    bitShiftLeft(*this, b);
+}
+inline void BigUnsigned::operator>>=(Index b) {
+    bitShiftRight(*this, b);
+}
 
 /* Templates for conversions fo BigUnsigned to and from primitive integers */
 
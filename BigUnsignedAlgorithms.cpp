@@ -0,0 +1,918 @@
+#include "BigUnsignedAlgorithms.h"
+#include "BarrettContext.h"
+#include "MontgomeryContext.h"
+#include "BlockArithmetic.h"
+#include <algorithm>
+#include <random>
+
+BigUnsigned modPow(const BigUnsigned &base, const BigUnsigned &exp,
+        const BigUnsigned &m) {
+    if (m.isZero())
+        throw "modPow: modulus is zero";
+    if (m.remainderBySmall(2) == 1)
+        return MontgomeryContext(m).modPow(base, exp);
+
+    // Right-to-left square and multiply, peeling the bits off a copy of exp
+    BarrettContext ctx(m);
+    BigUnsigned b = ctx.reduce(base), e = exp, r = ctx.reduce(BigUnsigned(1));
+    while (!e.isZero()) {
+        if (e.divideBySmall(2) == 1)
+            ctx.mulMod(r, r, b);
+        if (!e.isZero())
+            ctx.mulMod(b, b, b);
+    }
+    return r;
+}
+
+BigUnsigned modPowConstantTime(const BigUnsigned &base, const BigUnsigned &exp,
+        const BigUnsigned &m) {
+    if (m.isZero() || m.remainderBySmall(2) == 0)
+        throw "modPowConstantTime: modulus must be odd";
+    return MontgomeryContext(m).modPowConstantTime(base, exp);
+}
+
+/* Schönhage's half-gcd, in the subtractive form of Möller ("On Schönhage's
+ * algorithm and subquadratic integer gcd computation", 2008). For a and b of
+ * at most n blocks and s = n / 2 + 1, reduce() runs Euclid's algorithm on
+ * them for as long as both stay at least B^s, which takes them down to about
+ * n / 2 blocks, and collects the quotients in a matrix M with
+ * (a, b) = M (a', b'). Above BigUnsigned::halfGcdThreshold blocks most of M
+ * comes from two recursive calls on the leading blocks, each of which only
+ * needs a multiplication by M to carry over to the whole numbers; this is
+ * what brings a gcd down to O(M(n) log n).
+ */
+class HalfGcd {
+    public:
+        typedef BigUnsigned::Blk   Blk;
+        typedef BigUnsigned::Index Index;
+
+        /* A matrix of nonnegative numbers with determinant 1 */
+        struct Matrix {
+            BigUnsigned m00, m01, m10, m11;
+            Matrix() : m00(1), m01(0), m10(0), m11(1) {}
+        };
+
+        /* Reduces a and b in place, as above, and multiplies m, which should
+         * start out as the identity, by the matrix of the quotients taken.
+         * Returns false, changing nothing, if not even one could be taken.
+         */
+        static bool reduce(BigUnsigned &a, BigUnsigned &b, Matrix &m);
+
+    private:
+        /* x div B^p and x mod B^p */
+        static BigUnsigned high(const BigUnsigned &x, Index p) {
+            return (x.len > p) ? BigUnsigned(x.blk + p, x.len - p)
+                               : BigUnsigned();
+        }
+        static BigUnsigned low(const BigUnsigned &x, Index p) {
+            return BigUnsigned(x.blk, (x.len < p) ? x.len : p);
+        }
+        static BigUnsigned shifted(const BigUnsigned &x, Index p);
+        static BigUnsigned combine(const BigUnsigned &x, Blk u,
+                const BigUnsigned &y, Blk v);
+        static void swapContents(BigUnsigned &x, BigUnsigned &y);
+
+        static void multiply(Matrix &m, const Matrix &n);
+        static void multiply(Matrix &m, Blk n00, Blk n01, Blk n10, Blk n11);
+        static void adjust(BigUnsigned &a, BigUnsigned &b,
+                const BigUnsigned &ah, const BigUnsigned &bh, Index p,
+                const Matrix &m);
+
+        static bool divisionStep(BigUnsigned &a, BigUnsigned &b, Index s,
+                Matrix &m);
+        static bool lehmerStep(BigUnsigned &a, BigUnsigned &b, Index s,
+                Matrix &m);
+};
+
+/* x B^p */
+BigUnsigned HalfGcd::shifted(const BigUnsigned &x, Index p) {
+    if (x.isZero())
+        return x;
+    BigUnsigned r;
+    r.allocate(x.len + p);
+    BlockArithmetic::zeroBlocks(r.blk, p);
+    BlockArithmetic::copyBlocks(r.blk + p, x.blk, x.len);
+    r.len = x.len + p;
+    return r;
+}
+
+/* x u + y v */
+BigUnsigned HalfGcd::combine(const BigUnsigned &x, Blk u,
+        const BigUnsigned &y, Blk v) {
+    if (x.len < y.len)
+        return combine(y, v, x, u);
+    BigUnsigned r;
+    r.allocate(x.len + 2);
+    r.blk[x.len] = BlockArithmetic::mulBlocksByBlock(r.blk, x.blk, x.len, u);
+    r.blk[x.len + 1] = 0;
+    Blk carry = BlockArithmetic::addMulBlock(r.blk, y.blk, y.len, v);
+    BlockArithmetic::addBlock(r.blk + y.len, r.blk + y.len,
+            x.len + 2 - y.len, carry);
+    r.len = x.len + 2;
+    r.zapLeadingZeros();
+    return r;
+}
+
+void HalfGcd::swapContents(BigUnsigned &x, BigUnsigned &y) {
+    Blk *b = x.blk;
+    x.blk = y.blk;
+    y.blk = b;
+    Index t = x.len;
+    x.len = y.len;
+    y.len = t;
+    t = x.cap;
+    x.cap = y.cap;
+    y.cap = t;
+}
+
+/* m = m n */
+void HalfGcd::multiply(Matrix &m, const Matrix &n) {
+    BigUnsigned t00 = m.m00 * n.m00 + m.m01 * n.m10;
+    BigUnsigned t10 = m.m10 * n.m00 + m.m11 * n.m10;
+    m.m01 = m.m00 * n.m01 + m.m01 * n.m11;
+    m.m11 = m.m10 * n.m01 + m.m11 * n.m11;
+    m.m00 = t00;
+    m.m10 = t10;
+}
+
+void HalfGcd::multiply(Matrix &m, Blk n00, Blk n01, Blk n10, Blk n11) {
+    BigUnsigned t00 = combine(m.m00, n00, m.m01, n10);
+    BigUnsigned t10 = combine(m.m10, n00, m.m11, n10);
+    m.m01 = combine(m.m00, n01, m.m01, n11);
+    m.m11 = combine(m.m10, n01, m.m11, n11);
+    m.m00 = t00;
+    m.m10 = t10;
+}
+
+/* Carries a reduction of the leading blocks, ah = a div B^p and likewise bh,
+ * over to a and b: given that ah and bh have become ah' and bh' through m,
+ * a' = ah' B^p + m11 (a mod B^p) - m01 (b mod B^p), and b' likewise. Möller
+ * shows that with p chosen as reduce() does, a' and b' still exceed B^s.
+ */
+void HalfGcd::adjust(BigUnsigned &a, BigUnsigned &b, const BigUnsigned &ah,
+        const BigUnsigned &bh, Index p, const Matrix &m) {
+    BigUnsigned al = low(a, p), bl = low(b, p);
+    a = shifted(ah, p) + m.m11 * al - m.m01 * bl;
+    b = shifted(bh, p) + m.m00 * bl - m.m10 * al;
+}
+
+/* One quotient by division, taken one short if the full one would bring
+ * the remainder below B^s */
+bool HalfGcd::divisionStep(BigUnsigned &a, BigUnsigned &b, Index s,
+        Matrix &m) {
+    if (a.len <= s || b.len <= s)
+        return false;
+    BigUnsigned::CmpRes c = a.compareTo(b);
+    if (c == BigUnsigned::equal)
+        return false;
+    BigUnsigned &x = (c == BigUnsigned::greater) ? a : b;
+    BigUnsigned &y = (c == BigUnsigned::greater) ? b : a;
+    BigUnsigned q;
+    x.divideWithRemainder(y, q);
+    if (x.len <= s) {
+        x += y;
+        if (q == BigUnsigned(1))
+            return false;
+        q -= BigUnsigned(1);
+    }
+    // a -= q b makes m's second column gain q times its first; b -= q a
+    // the other way round
+    if (c == BigUnsigned::greater) {
+        m.m01 += q * m.m00;
+        m.m11 += q * m.m10;
+    } else {
+        m.m00 += q * m.m01;
+        m.m10 += q * m.m11;
+    }
+    return true;
+}
+
+/* Many quotients at once from the leading two blocks, for as long as the
+ * remainders provably stay at least B^s */
+bool HalfGcd::lehmerStep(BigUnsigned &a, BigUnsigned &b, Index s,
+        Matrix &m) {
+#ifdef BLOCKARITHMETIC_HAVE_DBLK
+    bool swapped = (a < b);
+    BigUnsigned &x = swapped ? b : a, &y = swapped ? a : b;
+    if (y.len <= s || x.len > y.len + 1)
+        return false;
+    BlockArithmetic::LehmerCofactors f;
+    if (!BlockArithmetic::lehmerCofactors(f, x.blk, x.len, y.blk, y.len,
+            long(s) * BigUnsigned::N))
+        return false;
+    y.allocateAndCopy(x.len);
+    BlockArithmetic::lehmerApply(f, x.blk, x.len, y.blk, y.len);
+
+    // Lehmer's (x, y) = L (x, y) swaps the pair once per quotient, so after
+    // an odd number of them the pair is swapped back; m then gains L^-1,
+    // with the swap folded in, which has nonnegative entries either way.
+    // If a and b came in swapped, so do the rows and columns of that.
+    bool odd = (f.quotients % 2 != 0);
+    Blk n00, n01, n10, n11;
+    if (odd) {
+        n00 = Blk(f.B);
+        n01 = Blk(-f.D);
+        n10 = Blk(-f.A);
+        n11 = Blk(f.C);
+    } else {
+        n00 = Blk(f.D);
+        n01 = Blk(-f.B);
+        n10 = Blk(-f.C);
+        n11 = Blk(f.A);
+    }
+    if (swapped)
+        multiply(m, n11, n10, n01, n00);
+    else
+        multiply(m, n00, n01, n10, n11);
+    if (odd)
+        swapContents(a, b);
+    return true;
+#else
+    (void)a; (void)b; (void)s; (void)m;
+    return false;
+#endif
+}
+
+bool HalfGcd::reduce(BigUnsigned &a, BigUnsigned &b, Matrix &m) {
+    Index n = (a.len > b.len) ? a.len : b.len, s = n / 2 + 1;
+    if (a.len <= s || b.len <= s)
+        return false;
+    bool progress = false;
+    if (n >= BigUnsigned::halfGcdThreshold) {
+        // The top half of the blocks take a and b down to about 3n / 4
+        Index p = n / 2;
+        BigUnsigned ah = high(a, p), bh = high(b, p);
+        if (reduce(ah, bh, m)) {
+            adjust(a, b, ah, bh, p, m);
+            progress = true;
+        }
+        while (((a.len > b.len) ? a.len : b.len) > 3 * n / 4 + 1) {
+            if (!divisionStep(a, b, s, m))
+                return progress;
+            progress = true;
+        }
+        // ... and the top 2 (n' - s) - 1 of what is left of them, where
+        // n' is its length, take them the rest of the way
+        Index n2 = (a.len > b.len) ? a.len : b.len;
+        if (n2 > s + 2) {
+            p = 2 * s - n2 + 1;
+            ah = high(a, p);
+            bh = high(b, p);
+            Matrix m2;
+            if (reduce(ah, bh, m2)) {
+                adjust(a, b, ah, bh, p, m2);
+                multiply(m, m2);
+                progress = true;
+            }
+        }
+    }
+    // The last few quotients, or all of them on short operands
+    while (lehmerStep(a, b, s, m) || divisionStep(a, b, s, m))
+        progress = true;
+    return progress;
+}
+
+BigUnsigned gcd(const BigUnsigned &a, const BigUnsigned &b) {
+    if (a.isZero())
+        return b;
+    if (b.isZero())
+        return a;
+    BigUnsigned u = a, v = b, q;
+    BigUnsigned *x = &u, *y = &v;
+    if (*x < *y) {
+        x = &v;
+        y = &u;
+    }
+
+    // x >= y > 0 throughout. Each half-gcd reduction takes about half the
+    // blocks off; a division step evens out operands that are too far apart
+    // in length for one.
+    while (y->len >= BigUnsigned::halfGcdThreshold) {
+        HalfGcd::Matrix m;
+        if (!HalfGcd::reduce(*x, *y, m))
+            x->divideWithRemainder(*y, q);
+        if (*x < *y) {
+            BigUnsigned *t = x;
+            x = y;
+            y = t;
+        }
+        if (y->isZero())
+            return *x;
+    }
+
+    // Lehmer's step writes as many blocks of y as x has; a division step
+    // swaps x and y, so y keeps that room from then on
+    y->allocateAndCopy(x->len);
+    while (y->len >= BigUnsigned::lehmerThreshold && y->len >= 2) {
+        bool stepped = false;
+#ifdef BLOCKARITHMETIC_HAVE_DBLK
+        if (x->len <= y->len + 1)
+            stepped = BlockArithmetic::lehmerStep(x->blk, x->len, y->blk, y->len);
+#endif
+        if (!stepped) {
+            x->divideWithRemainder(*y, q);
+            BigUnsigned *t = x;
+            x = y;
+            y = t;
+        }
+        if (y->isZero())
+            return *x;
+    }
+    // The binary algorithm only subtracts, which is slow to even out
+    // operands of different lengths
+    if (x->len > y->len) {
+        x->divideWithRemainder(*y, q);
+        if (x->isZero())
+            return *y;
+    }
+    x->len = BlockArithmetic::gcdBinary(x->blk, x->len, y->blk, y->len);
+    return *x;
+}
+
+int jacobi(const BigUnsigned &a, const BigUnsigned &n) {
+    if (n.isZero() || (n.blk[0] & 1) == 0)
+        throw "jacobi: n must be odd";
+    BigUnsigned u = n, v = a % n, q;
+    BigUnsigned *x = &u, *y = &v;
+    BlockArithmetic::JacobiState state;
+    state.x = u.blk[0];
+    state.y = v.isZero() ? 0 : v.blk[0];
+    state.denominatorIsX = true;
+    state.sign = 1;
+
+    // Euclid's algorithm as in gcd(), with the state following along
+    y->allocateAndCopy(x->len);
+    while (y->len >= BigUnsigned::jacobiLehmerThreshold && y->len >= 2) {
+        bool stepped = false;
+#ifdef BLOCKARITHMETIC_HAVE_DBLK
+        BlockArithmetic::LehmerCofactors f;
+        if (x->len <= y->len + 1 && BlockArithmetic::lehmerCofactors(f,
+                x->blk, x->len, y->blk, y->len, -1, &state)) {
+            BlockArithmetic::lehmerApply(f, x->blk, x->len, y->blk, y->len);
+            stepped = true;
+        }
+#endif
+        if (!stepped) {
+            BigUnsigned::Index e = 0;
+            BigUnsigned::Blk w = 0;
+            if ((y->blk[0] & 1) == 0) {
+                while (y->blk[e / BigUnsigned::N] == 0)
+                    e += BigUnsigned::N;
+                e += BlockArithmetic::countTrailingZeros(
+                        y->blk[e / BigUnsigned::N]);
+                w = (*y >> e).blk[0];
+            }
+            x->divideWithRemainder(*y, q);
+            state.advance(x->isZero() ? 0 : x->blk[0], e, w);
+            BigUnsigned *t = x;
+            x = y;
+            y = t;
+        }
+        if (y->isZero())
+            break;
+    }
+
+    // The binary algorithm on what is left, once evened out
+    BigUnsigned &num = state.denominatorIsX ? *y : *x;
+    BigUnsigned &den = state.denominatorIsX ? *x : *y;
+    if (num.len > den.len)
+        num %= den;
+    return state.sign
+        * BlockArithmetic::jacobiBinary(num.blk, num.len, den.blk, den.len);
+}
+
+BigUnsigned extendedGcd(const BigUnsigned &a, const BigUnsigned &m,
+        BigUnsigned &x) {
+    if (m.isZero())
+        throw "extendedGcd: modulus is zero";
+    // (a mod m, m) = M (u, v) for some M of determinant 1, of whose entries
+    // only the bottom row (c0, c1) is needed: u = M11 (a mod m) - M01 m
+    // and v = M00 m - M10 (a mod m)
+    BigUnsigned u = a % m, v = m, c0, c1(1), q;
+    while (!u.isZero() && !v.isZero()) {
+        HalfGcd::Matrix n;
+        if (HalfGcd::reduce(u, v, n)) {
+            BigUnsigned t = c0 * n.m00 + c1 * n.m10;
+            c1 = c0 * n.m01 + c1 * n.m11;
+            c0 = t;
+        } else if (u >= v) {
+            u.divideWithRemainder(v, q);
+            c1 += q * c0;
+        } else {
+            v.divideWithRemainder(u, q);
+            c0 += q * c1;
+        }
+    }
+    if (v.isZero()) {
+        x = c1 % m;
+        return u;
+    }
+    x = (m - c0 % m) % m;
+    return v;
+}
+
+BigUnsigned modInverse(const BigUnsigned &a, const BigUnsigned &m) {
+    if (m.isZero())
+        throw "modInverse: modulus is zero";
+    BigUnsigned r = a % m;
+    if ((m.blk[0] & 1) != 0 && m.len < BigUnsigned::binaryInverseThreshold) {
+        BigUnsigned x;
+        x.allocate(m.len);
+        if (!BlockArithmetic::inverseBinary(x.blk, r.blk, r.len, m.blk, m.len))
+            throw "modInverse: value is not invertible modulo m";
+        x.len = m.len;
+        x.zapLeadingZeros();
+        return x;
+    }
+    BigUnsigned x;
+    if (extendedGcd(r, m, x) != BigUnsigned(1))
+        throw "modInverse: value is not invertible modulo m";
+    return x;
+}
+
+void modInverseBatch(std::vector<BigUnsigned> &values, const BigUnsigned &m) {
+    if (values.empty())
+        return;
+    if (m.isZero())
+        throw "modInverseBatch: modulus is zero";
+    // prefix[i] = values[0] ... values[i] mod m
+    BarrettContext ctx(m);
+    std::vector<BigUnsigned> prefix(values.size());
+    prefix[0] = ctx.reduce(values[0]);
+    for (std::size_t i = 1; i < values.size(); ++i)
+        ctx.mulMod(prefix[i], prefix[i - 1], ctx.reduce(values[i]));
+
+    // Walking back down, inv is the inverse of prefix[i], from which
+    // values[i] drops out with prefix[i - 1], and prefix[i - 1] with
+    // values[i]
+    BigUnsigned inv = modInverse(prefix.back(), m), t;
+    for (std::size_t i = values.size() - 1; i > 0; --i) {
+        ctx.mulMod(t, inv, prefix[i - 1]);
+        ctx.mulMod(inv, inv, ctx.reduce(values[i]));
+        values[i] = t;
+    }
+    values[0] = inv;
+}
+
+namespace {
+
+typedef BigUnsigned::Blk Blk;
+
+/* b^e by left-to-right square and multiply */
+BigUnsigned power(const BigUnsigned &b, unsigned int e) {
+    BigUnsigned r(1);
+    for (unsigned int bit = 1u << 31; bit != 0; bit >>= 1) {
+        r.square(r);
+        if ((e & bit) != 0)
+            r *= b;
+    }
+    return r;
+}
+
+/* Whether r^k <= x, without overflowing */
+bool powerAtMost(Blk r, unsigned int k, Blk x) {
+    if (r == 0)
+        return true;
+    Blk p = 1;
+    for (unsigned int i = 0; i < k; ++i) {
+        if (p > x / r)
+            return false;
+        p *= r;
+    }
+    return true;
+}
+
+/* floor(x^(1/k)) for a single block, one bit at a time from the top. The
+ * root is below 2^ceil(N / k). */
+Blk rootBlock(Blk x, unsigned int k) {
+    unsigned int top = (BigUnsigned::N + k - 1) / k;
+    Blk r = 0;
+    for (unsigned int bit = (top < BigUnsigned::N) ? top : BigUnsigned::N;
+            bit > 0; --bit) {
+        Blk c = r | (Blk(1) << (bit - 1));
+        if (powerAtMost(c, k, x))
+            r = c;
+    }
+    return r;
+}
+
+/* One step of Newton's iteration for the k-th root of x from r > 0:
+ * ((k - 1) r + x / r^(k - 1)) / k, which is at least floor(x^(1/k)) by
+ * the inequality of arithmetic and geometric means, and below r unless r
+ * is already that
+ */
+BigUnsigned newtonRootStep(const BigUnsigned &x, unsigned int k,
+        const BigUnsigned &r) {
+    BigUnsigned t = x / power(r, k - 1);
+    t += r * BigUnsigned(Blk(k - 1));
+    t.divideBySmall(k);
+    return t;
+}
+
+}
+
+BigUnsigned iroot(const BigUnsigned &x, unsigned int k) {
+    if (k == 0)
+        throw "iroot: k is zero";
+    if (k == 1 || x.isZero())
+        return x;
+    BigUnsigned::Index n = x.bitLength();
+    if (n <= BigUnsigned::N)
+        return BigUnsigned(rootBlock(x.toUnsignedLong(), k));
+    // x < 2^n <= 2^k
+    if (k >= n)
+        return BigUnsigned(1);
+
+    // The root of x / 2^(kj), scaled back up by 2^j, falls short of the
+    // root of x by less than 2^j, or about its square root for this j; one
+    // Newton step then leaves it at most about k / 2 too large. The
+    // recursion works on half the bits each time down, so the divisions at
+    // full length are only the last few.
+    BigUnsigned::Index j = (n - 1) / (2 * k);
+    BigUnsigned r;
+    if (j == 0)
+        r = BigUnsigned(1) << ((n + k - 1) / k);
+    else
+        r = newtonRootStep(x, k, iroot(x >> (k * j), k) << j);
+    // From above, Newton's iteration decreases until it reaches the root
+    for (;;) {
+        BigUnsigned next = newtonRootStep(x, k, r);
+        if (next >= r)
+            return r;
+        r = next;
+    }
+}
+
+BigUnsigned isqrt(const BigUnsigned &x) {
+    return iroot(x, 2);
+}
+
+// PRIMALITY
+
+namespace {
+
+/* The odd primes below a limit, by the sieve of Eratosthenes, in runs whose
+ * products fit in a block, so that one remainderBySmall pass over a value
+ * finds its residues modulo a whole run
+ */
+struct SmallPrimes {
+    std::vector<Blk> primes, products;
+    // The end of each run in primes
+    std::vector<unsigned int> ends;
+
+    SmallPrimes(unsigned int limit) {
+        std::vector<bool> composite(limit);
+        for (unsigned int p = 3; p < limit; p += 2) {
+            if (composite[p])
+                continue;
+            for (unsigned long q = (unsigned long)p * p; q < limit; q += 2 * p)
+                composite[q] = true;
+            if (!products.empty() && products.back() <= ~Blk(0) / p) {
+                products.back() *= p;
+                ends.back()++;
+            } else {
+                products.push_back(p);
+                ends.push_back(primes.size() + 1);
+            }
+            primes.push_back(p);
+        }
+    }
+};
+
+// Trial division stops at 2^15; sieving, which costs far less per prime,
+// goes on to 2^20
+const SmallPrimes &trialPrimes() {
+    static const SmallPrimes table(1u << 15);
+    return table;
+}
+
+const SmallPrimes &sievePrimes() {
+    static const SmallPrimes table(1u << 20);
+    return table;
+}
+
+enum Verdict { composite, prime, undecided };
+
+/* Trial division by the small primes, which settles x < 3, even x, and x
+ * below the square of the largest of them
+ */
+Verdict trialDivision(const BigUnsigned &x) {
+    if (x.remainderBySmall(2) == 0)
+        return (x == BigUnsigned(2)) ? prime : composite;
+    if (x == BigUnsigned(1))
+        return composite;
+    const SmallPrimes &table = trialPrimes();
+    unsigned int i = 0;
+    for (unsigned int run = 0; run < table.products.size(); ++run) {
+        Blk r = x.remainderBySmall(table.products[run]);
+        for (; i < table.ends[run]; ++i)
+            if (r % table.primes[i] == 0)
+                return (x == BigUnsigned(table.primes[i])) ? prime : composite;
+    }
+    Blk last = table.primes.back();
+    return (x < BigUnsigned(last) * BigUnsigned(last)) ? prime : undecided;
+}
+
+bool isZero(const std::vector<Blk> &x) {
+    for (unsigned int i = 0; i < x.size(); ++i)
+        if (x[i] != 0)
+            return false;
+    return true;
+}
+
+/* Strong probable-prime tests modulo the odd modulus x of a context: with
+ * x - 1 = d 2^s and d odd, x passes to base a when a^d = 1 or one of the
+ * squarings of a^d reaches -1
+ */
+class StrongTest {
+    public:
+        StrongTest(const MontgomeryContext &ctx);
+        bool passes(const BigUnsigned &a);
+
+    private:
+        const MontgomeryContext &ctx;
+        BigUnsigned d;
+        BigUnsigned::Index s;
+        // -1 in Montgomery form, the running power, and montSqr's scratch
+        std::vector<Blk> minusOne, y, ws;
+};
+
+StrongTest::StrongTest(const MontgomeryContext &ctx)
+        : ctx(ctx), s(0), minusOne(ctx.getLength()), y(ctx.getLength()),
+        ws(ctx.getScratchSize()) {
+    BigUnsigned xm1 = ctx.getModulus() - BigUnsigned(1);
+    d = xm1;
+    while (d.remainderBySmall(2) == 0) {
+        d >>= 1;
+        ++s;
+    }
+    ctx.toMontgomery(&minusOne[0], xm1);
+}
+
+bool StrongTest::passes(const BigUnsigned &a) {
+    BigUnsigned::Index k = ctx.getLength();
+    const Blk *one = ctx.getOne();
+    ctx.toMontgomery(&y[0], ctx.modPow(a, d));
+    if (BlockArithmetic::compareBlocks(&y[0], one, k) == 0)
+        return true;
+    for (BigUnsigned::Index j = 0; ; ++j) {
+        if (BlockArithmetic::compareBlocks(&y[0], &minusOne[0], k) == 0)
+            return true;
+        // Squaring anything else to 1 would take a square root of 1 other
+        // than +-1, so stopping at 1 changes nothing
+        if (j + 1 == s || BlockArithmetic::compareBlocks(&y[0], one, k) == 0)
+            return false;
+        ctx.montSqr(&y[0], &y[0], &ws[0]);
+    }
+}
+
+/* r = c a mod n for c > 0, by doubling and adding; r must not be a */
+void mulSmallMod(const MontgomeryContext &ctx, Blk *r, const Blk *a, Blk c) {
+    BlockArithmetic::copyBlocks(r, a, ctx.getLength());
+    for (unsigned int bit = BigUnsigned::N - 1
+            - BlockArithmetic::countLeadingZeros(c); bit > 0; --bit) {
+        ctx.addMod(r, r, r);
+        if (((c >> (bit - 1)) & 1) != 0)
+            ctx.addMod(r, r, a);
+    }
+}
+
+/* The strong Lucas probable-prime test modulo the odd modulus x of a
+ * context, with Selfridge's parameters: the first D of 5, -7, 9, -11, ...
+ * for which (D/x) = -1, P = 1 and Q = (1 - D) / 4. With x + 1 = d 2^s and d
+ * odd, x passes when U_d = 0 or V_(d 2^r) = 0 for some r < s. The sequences
+ * run up the bits of d in Montgomery form, doubling by U_2k = U_k V_k and
+ * V_2k = V_k^2 - 2 Q^k and stepping by U_(k+1) = (U_k + V_k) / 2 and
+ * V_(k+1) = (D U_k + V_k) / 2, so that D and Q, being small, only ever
+ * take additions.
+ */
+bool strongLucasTest(const MontgomeryContext &ctx) {
+    const BigUnsigned &x = ctx.getModulus();
+    long D = 5;
+    for (;;) {
+        int j = jacobi((D > 0) ? BigUnsigned(Blk(D)) : x - BigUnsigned(Blk(-D)),
+                x);
+        if (j == -1)
+            break;
+        if (j == 0)
+            return false;
+        // No D will do for a square, so rule one out once the likeliest
+        // few have failed
+        if (D == -11) {
+            BigUnsigned r = isqrt(x);
+            if (r * r == x)
+                return false;
+        }
+        D = (D > 0) ? -(D + 2) : -D + 2;
+    }
+    long Q = (1 - D) / 4;
+    Blk absD = (D > 0) ? D : -D, absQ = (Q > 0) ? Q : -Q;
+
+    BigUnsigned d = x + BigUnsigned(1);
+    BigUnsigned::Index s = 0;
+    while (d.remainderBySmall(2) == 0) {
+        d >>= 1;
+        ++s;
+    }
+    BigUnsigned::Index k = ctx.getLength();
+    std::vector<Blk> u(ctx.getOne(), ctx.getOne() + k), v(u), q(k), t(k),
+        zero(k), ws(ctx.getScratchSize());
+    ctx.toMontgomery(&q[0], (Q > 0) ? BigUnsigned(absQ) : x - BigUnsigned(absQ));
+    for (BigUnsigned::Index i = d.bitLength() - 1; i > 0; --i) {
+        ctx.montMul(&t[0], &u[0], &v[0]);
+        u.swap(t);
+        ctx.montSqr(&v[0], &v[0], &ws[0]);
+        ctx.addMod(&t[0], &q[0], &q[0]);
+        ctx.subMod(&v[0], &v[0], &t[0]);
+        ctx.montSqr(&q[0], &q[0], &ws[0]);
+        if (d.getBit(i - 1)) {
+            mulSmallMod(ctx, &t[0], &u[0], absD);
+            if (D > 0)
+                ctx.addMod(&t[0], &v[0], &t[0]);
+            else
+                ctx.subMod(&t[0], &v[0], &t[0]);
+            ctx.addMod(&u[0], &u[0], &v[0]);
+            ctx.halveMod(&u[0], &u[0]);
+            ctx.halveMod(&v[0], &t[0]);
+            mulSmallMod(ctx, &t[0], &q[0], absQ);
+            if (Q > 0)
+                q.swap(t);
+            else
+                ctx.subMod(&q[0], &zero[0], &t[0]);
+        }
+    }
+    if (isZero(u) || isZero(v))
+        return true;
+    for (BigUnsigned::Index r = 1; r < s; ++r) {
+        ctx.montSqr(&v[0], &v[0], &ws[0]);
+        ctx.addMod(&t[0], &q[0], &q[0]);
+        ctx.subMod(&v[0], &v[0], &t[0]);
+        if (isZero(v))
+            return true;
+        ctx.montSqr(&q[0], &q[0], &ws[0]);
+    }
+    return false;
+}
+
+/* 64 bits from the system's random device */
+unsigned long long deviceSeed() {
+    std::random_device source;
+    return (static_cast<unsigned long long>(source()) << 32) ^ source();
+}
+
+/* The source of the Miller-Rabin bases: one generator per thread, seeded
+ * from the device the first time the thread needs it rather than per call
+ */
+std::mt19937_64 &baseGenerator() {
+    thread_local std::mt19937_64 generator(deviceSeed());
+    return generator;
+}
+
+}
+
+bool isProbablePrime(const BigUnsigned &x, unsigned int rounds) {
+    Verdict verdict = trialDivision(x);
+    if (verdict != undecided)
+        return verdict == prime;
+
+    MontgomeryContext ctx(x);
+    StrongTest test(ctx);
+    BigUnsigned span = x - BigUnsigned(3);
+    BigUnsigned::Index blocks =
+        (x.bitLength() + BigUnsigned::N - 1) / BigUnsigned::N;
+    std::vector<Blk> random(blocks);
+    std::mt19937_64 &generator = baseGenerator();
+    // Each round, a base in [2, x - 2]
+    for (unsigned int round = 0; round < rounds; ++round) {
+        for (BigUnsigned::Index j = 0; j < blocks; ++j)
+            random[j] = Blk(generator());
+        if (!test.passes(BigUnsigned(&random[0], blocks) % span
+                + BigUnsigned(2)))
+            return false;
+    }
+    return true;
+}
+
+bool isProbablePrime(const BigUnsigned &x) {
+    Verdict verdict = trialDivision(x);
+    if (verdict != undecided)
+        return verdict == prime;
+    MontgomeryContext ctx(x);
+    return StrongTest(ctx).passes(BigUnsigned(2)) && strongLucasTest(ctx);
+}
+
+namespace {
+
+/* The least odd x >= start, of more than 40 bits, that passes
+ * isProbablePrime and has x - 1 prime to e, and if safe also 2x + 1 passing
+ * it; zero if *stop turns true first. The window covers x + 2i for i below
+ * its length; the residues of x modulo each sieving prime, and of x - 1
+ * modulo e, follow it as it moves. A prime q takes an update and about 1/q
+ * of the window to sieve by, against a full test saved for about 1/q of
+ * the numbers, so the bound grows with the cost of the test.
+ */
+BigUnsigned sieveSearch(const BigUnsigned &start, Blk e, bool safe,
+        const std::atomic<bool> *stop) {
+    const SmallPrimes &table = sievePrimes();
+    Blk bound = std::min<Blk>(std::max<Blk>(256 * start.bitLength(), 1u << 16),
+            1u << 20);
+    unsigned int count = std::lower_bound(table.primes.begin(),
+            table.primes.end(), bound) - table.primes.begin();
+    BigUnsigned x = start;
+    if (x.remainderBySmall(2) == 0)
+        x += BigUnsigned(1);
+    std::vector<Blk> residues(count);
+    for (unsigned int run = 0, i = 0; i < count; ++run) {
+        Blk r = x.remainderBySmall(table.products[run]);
+        for (; i < table.ends[run] && i < count; ++i)
+            residues[i] = r % table.primes[i];
+    }
+    Blk re = (x - BigUnsigned(1)).remainderBySmall(e);
+    const unsigned int window = std::max<BigUnsigned::Index>(256, x.bitLength());
+    std::vector<bool> struck(window);
+    for (;;) {
+        std::fill(struck.begin(), struck.end(), false);
+        for (unsigned int j = 0; j < count; ++j) {
+            // x + 2i = 0 mod q for i = -r / 2 = (q - r) (q + 1) / 2 mod q,
+            // and 2 (x + 2i) + 1 = 0 for x + 2i = (q - 1) / 2
+            Blk q = table.primes[j];
+            unsigned long long i = (unsigned long long)((q - residues[j]) % q)
+                * ((q + 1) / 2) % q;
+            for (; i < window; i += q)
+                struck[i] = true;
+            if (!safe)
+                continue;
+            i = (unsigned long long)(((q - 1) / 2 + q - residues[j]) % q)
+                * ((q + 1) / 2) % q;
+            for (; i < window; i += q)
+                struck[i] = true;
+        }
+        for (unsigned int i = 0; i < window; ++i) {
+            if (struck[i])
+                continue;
+            // (x + 2i - 1) mod e, without overflowing
+            Blk t = Blk(2 * i) % e, m = re + t;
+            if (m < re || m >= e)
+                m -= e;
+            if (BlockArithmetic::gcdBlock(m, e) != 1)
+                continue;
+            if (stop && *stop)
+                return BigUnsigned();
+            BigUnsigned c = x + BigUnsigned(Blk(2 * i));
+            if (isProbablePrime(c) && (!safe
+                    || isProbablePrime((c << 1) + BigUnsigned(1))))
+                return c;
+        }
+        x += BigUnsigned(Blk(2 * window));
+        for (unsigned int j = 0; j < count; ++j)
+            residues[j] = (residues[j] + 2 * window) % table.primes[j];
+        Blk t = Blk(2 * window) % e, m = re + t;
+        re = (m < re || m >= e) ? m - e : m;
+    }
+}
+
+}
+
+BigUnsigned nextProbablePrime(const BigUnsigned &start, Blk e,
+        const std::atomic<bool> *stop) {
+    if (e == 0)
+        throw "nextProbablePrime: e is zero";
+    // Below the square of the sieving primes, where the sieve would strike
+    // out the primes themselves, and where there are few candidates anyway
+    if (start.bitLength() <= 40) {
+        if (start <= BigUnsigned(2))
+            return BigUnsigned(2);
+        BigUnsigned x = start;
+        if (x.remainderBySmall(2) == 0)
+            x += BigUnsigned(1);
+        while (!isProbablePrime(x) || BlockArithmetic::gcdBlock(
+                (x - BigUnsigned(1)).remainderBySmall(e), e) != 1) {
+            if (stop && *stop)
+                return BigUnsigned();
+            x += BigUnsigned(2);
+        }
+        return x;
+    }
+    return sieveSearch(start, e, false, stop);
+}
+
+BigUnsigned nextSafePrime(const BigUnsigned &start,
+        const std::atomic<bool> *stop) {
+    // p = 2q + 1 >= start for q >= floor(start / 2)
+    BigUnsigned q = start >> 1;
+    if (q.bitLength() <= 40) {
+        if (q < BigUnsigned(2))
+            q = BigUnsigned(2);
+        while (!isProbablePrime(q)
+                || !isProbablePrime((q << 1) + BigUnsigned(1))) {
+            if (stop && *stop)
+                return BigUnsigned();
+            q += BigUnsigned(1);
+        }
+    } else {
+        q = sieveSearch(q, 1, true, stop);
+        if (q.isZero())
+            return q;
+    }
+    return (q << 1) + BigUnsigned(1);
+}
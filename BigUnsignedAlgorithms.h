@@ -0,0 +1,109 @@
+#ifndef BIGUNSIGNEDALGORITHMS_H
+#define BIGUNSIGNEDALGORITHMS_H
+
+#include <atomic>
+#include <vector>
+#include "BigUnsigned.h"
+
+/* Number-theoretic algorithms built on BigUnsigned's public interface and on
+ * the reduction contexts.
+ */
+
+/* base^exp mod m. Odd moduli, the case that matters for cryptography, go
+ * through a MontgomeryContext; even ones through a BarrettContext. Throws an
+ * exception if m is zero. The time taken depends on exp.
+ */
+BigUnsigned modPow(const BigUnsigned &base, const BigUnsigned &exp,
+        const BigUnsigned &m);
+
+/* Likewise, in time independent of the value of exp, for private keys. The
+ * modulus must be odd; throws an exception otherwise.
+ */
+BigUnsigned modPowConstantTime(const BigUnsigned &base, const BigUnsigned &exp,
+        const BigUnsigned &m);
+
+/* The greatest common divisor of a and b; gcd(a, 0) = a. Operands of at
+ * least BigUnsigned::halfGcdThreshold blocks go through the half-gcd, in
+ * O(M(n) log n) time for multiplications costing M(n), those of at least
+ * BigUnsigned::lehmerThreshold blocks through Lehmer's algorithm, and the
+ * rest through the binary algorithm; a division step comes in whenever one
+ * operand is much longer than the other.
+ */
+BigUnsigned gcd(const BigUnsigned &a, const BigUnsigned &b);
+
+/* The Jacobi symbol (a/n), for odd n: 1, -1, or 0 when a and n share a
+ * factor. Operands of at least BigUnsigned::jacobiLehmerThreshold blocks
+ * take Lehmer's steps, with the sign followed through the plain remainders, and
+ * the rest the binary algorithm. Throws an exception if n is even.
+ */
+int jacobi(const BigUnsigned &a, const BigUnsigned &n);
+
+/* The greatest common divisor g of a and m, together with x < m such that
+ * a x = g (mod m); when g is 1, x is the inverse of a modulo m. Throws an
+ * exception if m is zero. Runs on the half-gcd, so it also takes
+ * O(M(n) log n) time.
+ */
+BigUnsigned extendedGcd(const BigUnsigned &a, const BigUnsigned &m,
+        BigUnsigned &x);
+
+/* 1/a mod m. Odd moduli of fewer than BigUnsigned::binaryInverseThreshold
+ * blocks go through the extended binary algorithm, the rest through
+ * extendedGcd. Throws an exception if m is zero or a is not prime to m.
+ */
+BigUnsigned modInverse(const BigUnsigned &a, const BigUnsigned &m);
+
+/* Replaces every value by its inverse modulo m at the cost of a single
+ * modInverse and 3 (k - 1) multiplications modulo m for k values
+ * (Montgomery's trick): the inverse of the product of all of them yields
+ * each one's inverse once multiplied by all the others. Throws an exception,
+ * leaving the values alone, if m is zero or any of them is not prime to m.
+ */
+void modInverseBatch(std::vector<BigUnsigned> &values, const BigUnsigned &m);
+
+/* floor(x^(1/k)) and floor(sqrt(x)), by Newton's iteration. The starting
+ * point comes from the root of the leading half of the bits of x, found the
+ * same way, so that each level of the recursion runs at the precision it
+ * needs and the whole costs a few divisions at full length. iroot throws an
+ * exception if k is zero.
+ */
+BigUnsigned iroot(const BigUnsigned &x, unsigned int k);
+BigUnsigned isqrt(const BigUnsigned &x);
+
+/* Whether x is probably prime. Trial division by the odd primes below 2^15
+ * comes first, several primes to each single-block remainder, and settles
+ * every x below the square of the largest of them; the rest then take the
+ * given number of Miller-Rabin rounds to random bases, all on one
+ * MontgomeryContext. A composite survives each round with probability at
+ * most 1/4.
+ */
+bool isProbablePrime(const BigUnsigned &x, unsigned int rounds);
+
+/* Whether x is prime by the Baillie-PSW test: the same trial division, then
+ * a strong test to base 2 and a strong Lucas test with Selfridge's
+ * parameters, the Lucas sequences run in Montgomery form. No composite is
+ * known to pass, and it costs about three Miller-Rabin rounds. This is the
+ * test to use by default.
+ */
+bool isProbablePrime(const BigUnsigned &x);
+
+/* The least p >= start that passes isProbablePrime and has p - 1 prime to
+ * e, so e = 1 asks for any prime. The residues of start modulo the odd
+ * primes up to a bound, which grows with the length of start up to 2^20,
+ * are found once; a window of the odd numbers from there is then sieved by
+ * them, and moved on, with single-block arithmetic alone, so only the
+ * numbers left standing take the full test. When stop is given, the search
+ * gives up and returns zero once *stop is true, so that another thread can
+ * call off a search it no longer needs. Throws an exception if e is zero.
+ */
+BigUnsigned nextProbablePrime(const BigUnsigned &start, BigUnsigned::Blk e,
+        const std::atomic<bool> *stop = NULL);
+
+/* The least safe prime p >= start, one for which (p - 1) / 2 is prime too,
+ * both by isProbablePrime. The search runs over (p - 1) / 2 with the same
+ * sieve, which also strikes out the numbers that make p divisible by a
+ * sieving prime. Stops as nextProbablePrime does.
+ */
+BigUnsigned nextSafePrime(const BigUnsigned &start,
+        const std::atomic<bool> *stop = NULL);
+
+#endif
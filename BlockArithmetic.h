@@ -0,0 +1,458 @@
+#ifndef BLOCKARITHMETIC_H
+#define BLOCKARITHMETIC_H
+
+#include <climits>
+#include "BigUnsigned.h"
+
+/* Low-level kernels that work on raw little-endian arrays of BigUnsigned
+ * blocks. BigUnsigned is built on top of these. They know nothing about
+ * capacities or leading zeros: the caller sizes every output array, and unless
+ * a comment says otherwise an output must not overlap an input.
+ */
+namespace BlockArithmetic {
+
+typedef BigUnsigned::Blk   Blk;
+typedef BigUnsigned::Index Index;
+
+// Number of bits in a block
+const unsigned int N = 8 * sizeof(Blk);
+
+/* Use a compiler-provided double-width type for block products when there is
+ * one; otherwise mulBlock falls back to multiplying half blocks.
+ */
+#if defined(__SIZEOF_INT128__) && ULONG_MAX == 0xffffffffffffffffUL
+#define BLOCKARITHMETIC_HAVE_DBLK
+typedef unsigned __int128 DBlk;
+typedef __int128 SDBlk;
+#elif ULONG_MAX == 0xffffffffUL
+#define BLOCKARITHMETIC_HAVE_DBLK
+typedef unsigned long long DBlk;
+typedef long long SDBlk;
+#endif
+
+// SINGLE-BLOCK PRIMITIVES
+
+/* Returns the low block of a * b and stores the high block in hi */
+inline Blk mulBlock(Blk a, Blk b, Blk &hi) {
+#ifdef BLOCKARITHMETIC_HAVE_DBLK
+    DBlk p = DBlk(a) * b;
+    hi = Blk(p >> N);
+    return Blk(p);
+#else
+    const unsigned int H = N / 2;
+    const Blk mask = (Blk(1) << H) - 1;
+    Blk a0 = a & mask, a1 = a >> H, b0 = b & mask, b1 = b >> H;
+    Blk p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+    // Sum of the three products that straddle the middle; cannot overflow
+    Blk mid = (p00 >> H) + (p01 & mask) + (p10 & mask);
+    hi = p11 + (p01 >> H) + (p10 >> H) + (mid >> H);
+    return (mid << H) | (p00 & mask);
+#endif
+}
+
+/* Divides hi B + lo by d, where d has its top bit set and hi < d. Returns the
+ * quotient and stores the remainder in r.
+ */
+inline Blk divBlock(Blk hi, Blk lo, Blk d, Blk &r) {
+#ifdef BLOCKARITHMETIC_HAVE_DBLK
+    DBlk u = (DBlk(hi) << N) | lo;
+    Blk q = Blk(u / d);
+    r = Blk(u - DBlk(q) * d);
+    return q;
+#else
+    // Two half-block steps of schoolbook division (Hacker's Delight, divlu)
+    const unsigned int H = N / 2;
+    const Blk b = Blk(1) << H, mask = b - 1;
+    Blk d1 = d >> H, d0 = d & mask, l1 = lo >> H, l0 = lo & mask;
+    Blk q1 = hi / d1, rhat = hi - q1 * d1;
+    while (q1 >= b || q1 * d0 > ((rhat << H) | l1)) {
+        --q1;
+        rhat += d1;
+        if (rhat >= b)
+            break;
+    }
+    Blk mid = (hi << H) + l1 - q1 * d;
+    Blk q0 = mid / d1;
+    rhat = mid - q0 * d1;
+    while (q0 >= b || q0 * d0 > ((rhat << H) | l0)) {
+        --q0;
+        rhat += d1;
+        if (rhat >= b)
+            break;
+    }
+    r = (mid << H) + l0 - q0 * d;
+    return (q1 << H) | q0;
+#endif
+}
+
+/* The reciprocal of a divisor d with its top bit set, in the form used by
+ * divBlockPreinv: floor((B^2 - 1) / d) - B. Costs one hardware division.
+ */
+inline Blk reciprocalBlock(Blk d) {
+    Blk r;
+    return divBlock(~d, ~Blk(0), d, r);
+}
+
+/* Like divBlock, with v = reciprocalBlock(d) computed in advance: one
+ * multiplication and a couple of adjustments instead of a division
+ * (Moller and Granlund, "Improved division by invariant integers", 2011).
+ */
+inline Blk divBlockPreinv(Blk hi, Blk lo, Blk d, Blk v, Blk &r) {
+    Blk q1, q0 = mulBlock(v, hi, q1);
+    q0 += lo;
+    q1 += hi + (q0 < lo) + 1;
+    Blk rem = lo - q1 * d;
+    if (rem > q0) {
+        --q1;
+        rem += d;
+    }
+    if (rem >= d) {
+        ++q1;
+        rem -= d;
+    }
+    r = rem;
+    return q1;
+}
+
+/* Number of leading zero bits in a nonzero block */
+inline unsigned int countLeadingZeros(Blk x) {
+#if defined(__GNUC__)
+    return __builtin_clzl(x);
+#else
+    unsigned int n = 0;
+    for (Blk top = Blk(1) << (N - 1); !(x & top); x <<= 1)
+        ++n;
+    return n;
+#endif
+}
+
+/* Number of trailing zero bits in a nonzero block */
+inline unsigned int countTrailingZeros(Blk x) {
+#if defined(__GNUC__)
+    return __builtin_ctzl(x);
+#else
+    unsigned int n = 0;
+    for (; !(x & 1); x >>= 1)
+        ++n;
+    return n;
+#endif
+}
+
+/* 1/d mod B for odd d. Newton's iteration doubles the correct low bits each
+ * time, starting from 3 (d d = 1 mod 8 for odd d).
+ */
+inline Blk inverseBlockModBase(Blk d) {
+    Blk inv = d;
+    for (unsigned int bits = 3; bits < N; bits *= 2)
+        inv *= 2 - d * inv;
+    return inv;
+}
+
+/* Number of set bits in a block */
+inline unsigned int countOnes(Blk x) {
+#if defined(__GNUC__)
+    return __builtin_popcountl(x);
+#else
+    unsigned int n = 0;
+    for (; x != 0; x &= x - 1)
+        ++n;
+    return n;
+#endif
+}
+
+// ARRAY PRIMITIVES
+// These may be called with r equal to (but not otherwise overlapping) an input.
+
+/* r = a + b over n blocks; returns the carry out */
+inline Blk addBlocks(Blk *r, const Blk *a, const Blk *b, Index n) {
+    Blk carry = 0;
+    for (Index i = 0; i < n; ++i) {
+        Blk s = a[i] + carry;
+        carry = (s < carry);
+        s += b[i];
+        carry += (s < b[i]);
+        r[i] = s;
+    }
+    return carry;
+}
+
+/* r = a + c over n blocks; returns the carry out */
+inline Blk addBlock(Blk *r, const Blk *a, Index n, Blk c) {
+    for (Index i = 0; i < n; ++i) {
+        Blk s = a[i] + c;
+        c = (s < c);
+        r[i] = s;
+    }
+    return c;
+}
+
+/* r = a - b over n blocks; returns the borrow out */
+inline Blk subBlocks(Blk *r, const Blk *a, const Blk *b, Index n) {
+    Blk borrow = 0;
+    for (Index i = 0; i < n; ++i) {
+        Blk x = a[i], d = x - b[i];
+        Blk bo = (d > x);
+        r[i] = d - borrow;
+        borrow = bo | (d < borrow);
+    }
+    return borrow;
+}
+
+/* r = a - c over n blocks; returns the borrow out */
+inline Blk subBlock(Blk *r, const Blk *a, Index n, Blk c) {
+    for (Index i = 0; i < n; ++i) {
+        Blk x = a[i];
+        r[i] = x - c;
+        c = (x < c);
+    }
+    return c;
+}
+
+/* r = a * b over n blocks; returns the block that falls off the top */
+inline Blk mulBlocksByBlock(Blk *r, const Blk *a, Index n, Blk b) {
+    Blk carry = 0, hi;
+    for (Index i = 0; i < n; ++i) {
+        Blk lo = mulBlock(a[i], b, hi);
+        lo += carry;
+        carry = hi + (lo < carry);
+        r[i] = lo;
+    }
+    return carry;
+}
+
+/* r += a * b over n blocks; returns the carry out */
+inline Blk addMulBlock(Blk *r, const Blk *a, Index n, Blk b) {
+    Blk carry = 0, hi;
+    for (Index i = 0; i < n; ++i) {
+        Blk lo = mulBlock(a[i], b, hi);
+        lo += carry;
+        hi += (lo < carry);
+        Blk s = r[i] + lo;
+        carry = hi + (s < lo);
+        r[i] = s;
+    }
+    return carry;
+}
+
+/* r -= a * b over n blocks; returns the borrow out */
+inline Blk subMulBlock(Blk *r, const Blk *a, Index n, Blk b) {
+    Blk borrow = 0, hi;
+    for (Index i = 0; i < n; ++i) {
+        Blk lo = mulBlock(a[i], b, hi);
+        lo += borrow;
+        hi += (lo < borrow);
+        Blk x = r[i];
+        r[i] = x - lo;
+        borrow = hi + (x < lo);
+    }
+    return borrow;
+}
+
+/* r = a << s over n blocks, 0 < s < N; returns the bits shifted out */
+inline Blk shiftLeftBlocks(Blk *r, const Blk *a, Index n, unsigned int s) {
+    Blk out = 0;
+    for (Index i = 0; i < n; ++i) {
+        Blk x = a[i];
+        r[i] = (x << s) | out;
+        out = x >> (N - s);
+    }
+    return out;
+}
+
+/* r = a >> s over n blocks, 0 < s < N; returns the bits shifted out, at the
+ * top of the returned block
+ */
+inline Blk shiftRightBlocks(Blk *r, const Blk *a, Index n, unsigned int s) {
+    Blk out = 0;
+    for (Index i = n; i > 0; --i) {
+        Blk x = a[i - 1];
+        r[i - 1] = (x >> s) | out;
+        out = x << (N - s);
+    }
+    return out;
+}
+
+/* Compares two n-block arrays like BigUnsigned::compareTo */
+inline int compareBlocks(const Blk *a, const Blk *b, Index n) {
+    while (n > 0) {
+        --n;
+        if (a[n] != b[n])
+            return (a[n] > b[n]) ? 1 : -1;
+    }
+    return 0;
+}
+
+inline void copyBlocks(Blk *r, const Blk *a, Index n) {
+    for (Index i = 0; i < n; ++i)
+        r[i] = a[i];
+}
+
+inline void zeroBlocks(Blk *r, Index n) {
+    for (Index i = 0; i < n; ++i)
+        r[i] = 0;
+}
+
+// MULTIPLICATION (BlockMultiply.cpp)
+
+/* Number of scratch blocks multiplyBlocks needs for an an-by-bn product */
+Index multiplyScratchSize(Index an, Index bn);
+
+/* r[0, an + bn) = a * b, where an >= bn >= 1. ws must point to at least
+ * multiplyScratchSize(an, bn) blocks.
+ */
+void multiplyBlocks(Blk *r, const Blk *a, Index an, const Blk *b, Index bn,
+        Blk *ws);
+
+/* Likewise for squaring: r[0, 2n) = a^2, n >= 1 */
+Index squareScratchSize(Index n);
+void squareBlocks(Blk *r, const Blk *a, Index n, Blk *ws);
+
+/* The individual algorithms behind multiplyBlocks; exposed for testing and
+ * tuning. Karatsuba and Toom-Cook multiply two n-block operands; Toom-Cook
+ * allocates its own scratch and needs n >= 7 (Toom-3) or n >= 13 (Toom-4).
+ */
+void multiplySchoolbook(Blk *r, const Blk *a, Index an, const Blk *b, Index bn);
+Index karatsubaScratchSize(Index n);
+void multiplyKaratsuba(Blk *r, const Blk *a, const Blk *b, Index n, Blk *ws);
+void multiplyToom3(Blk *r, const Blk *a, const Blk *b, Index n);
+void multiplyToom4(Blk *r, const Blk *a, const Blk *b, Index n);
+
+/* Squaring variants. The Toom-Cook kernels above square when a == b. */
+void squareSchoolbook(Blk *r, const Blk *a, Index n);
+Index karatsubaSquareScratchSize(Index n);
+void squareKaratsuba(Blk *r, const Blk *a, Index n, Blk *ws);
+
+/* Transform multiplication works modulo primes just under 2^62 and needs
+ * 64-bit blocks. It takes any an, bn >= 1, allocates its own scratch, and
+ * transforms only once when squaring (a == b and an == bn). It throws an
+ * exception when that scratch, five times the transform length, would not
+ * fit in an Index.
+ */
+#if ULONG_MAX == 0xffffffffffffffffUL
+#define BLOCKARITHMETIC_HAVE_NTT
+void multiplyNtt(Blk *r, const Blk *a, Index an, const Blk *b, Index bn);
+
+/* r[0, len) = a * b mod (B^len - 1), for a power of two len >= 2 and
+ * an, bn <= len: half the transform length of the full product. The result
+ * may be B^len - 1 itself in place of 0. nttCyclicLength(n) is the smallest
+ * valid len >= n.
+ */
+Index nttCyclicLength(Index n);
+void multiplyNttCyclic(Blk *r, const Blk *a, Index an, const Blk *b, Index bn,
+        Index len);
+#endif
+
+// DIVISION (BlockDivide.cpp)
+
+/* Divides the un + 1 blocks of u by the dn blocks of d, where un >= dn >= 1
+ * and d has its top bit set. The top dn blocks of u must be less than d, as
+ * they are after shifting both operands left to normalize d. Writes the
+ * un - dn + 1 quotient blocks into q and leaves the remainder in u[0, dn).
+ */
+void divideBlocks(Blk *q, Blk *u, Index un, const Blk *d, Index dn);
+
+/* The algorithms behind divideBlocks, with the same contract: Knuth's
+ * Algorithm D, Burnikel and Ziegler's recursive division, and division by a
+ * Newton-iterated reciprocal. The last two allocate their own scratch.
+ */
+void divideSchoolbook(Blk *q, Blk *u, Index un, const Blk *d, Index dn);
+void divideBurnikelZiegler(Blk *q, Blk *u, Index un, const Blk *d, Index dn);
+void divideNewton(Blk *q, Blk *u, Index un, const Blk *d, Index dn);
+
+/* Division of n >= 1 blocks by a single nonzero block d, of any size. The
+ * first writes the n-block quotient into q, which may equal a; both return
+ * the remainder.
+ */
+Blk divideBlocksByBlock(Blk *q, const Blk *a, Index n, Blk d);
+Blk remainderBlocksByBlock(const Blk *a, Index n, Blk d);
+
+// GREATEST COMMON DIVISOR (BlockGcd.cpp)
+
+/* The gcd of two blocks, either of which may be zero */
+Blk gcdBlock(Blk a, Blk b);
+
+/* Stein's binary algorithm on arrays: subtract the smaller number from the
+ * larger and strip the trailing zeros of the difference, until they meet.
+ * a and b have an and bn blocks without leading zeros, both nonzero. Both
+ * are destroyed; the gcd goes into a and its length is returned.
+ */
+Index gcdBinary(Blk *a, Index an, Blk *b, Index bn);
+
+/* x = 1/a mod m by the extended binary algorithm, for odd m of n blocks and
+ * a < m of an blocks without leading zeros: the steps of gcdBinary on a and
+ * m, with cofactors modulo m that are halved along with them, up to N - 1
+ * bits at a time. x has n blocks. Returns false if a is not prime to m.
+ */
+bool inverseBinary(Blk *x, const Blk *a, Index an, const Blk *m, Index n);
+
+/* The Jacobi symbol (a/b) for odd b, by the binary algorithm: strip the
+ * factors of two from a, swap by quadratic reciprocity when a < b, and
+ * subtract. a and b have an and bn blocks without leading zeros; both are
+ * destroyed.
+ */
+int jacobiBinary(Blk *a, Index an, Blk *b, Index bn);
+
+/* The sign of a Jacobi symbol along Euclid's algorithm on x >= y, when only
+ * one of them need be odd. The symbol is sign (y/x) or sign (x/y), with the
+ * odd one as denominator. Reducing the numerator by multiples of the
+ * denominator leaves it alone; before the denominator is reduced, it swaps
+ * places with the numerator by reciprocity if that is odd, and otherwise
+ * picks up the factors that (2^e w / v) and (2^e w / v - q 2^e w) differ by.
+ * Those only depend on the low bits of the numbers, which are kept here.
+ */
+struct JacobiState {
+    // The low blocks of x and y
+    Blk x, y;
+    bool denominatorIsX;
+    int sign;
+
+    /* Accounts for one quotient, (x, y) -> (y, x - q y), given the low
+     * block r of x - q y and, if y is even, its number of trailing zero
+     * bits e and the low block w of y / 2^e.
+     */
+    void advance(Blk r, Index e, Blk w);
+    /* Likewise for a quotient q, from the low blocks alone. Returns false,
+     * changing nothing, if y has too many trailing zero bits for that.
+     */
+    bool step(Blk q);
+};
+
+#ifdef BLOCKARITHMETIC_HAVE_DBLK
+/* The cofactors of one step of Lehmer's algorithm, which replaces a and b by
+ * A a + B b and C a + D b. After an even number of quotients A > 0 >= B and
+ * D > 0 >= C; after an odd number, the other way round.
+ */
+struct LehmerCofactors {
+    SDBlk A, B, C, D;
+    unsigned int quotients;
+};
+
+/* Runs Euclid's algorithm on the leading two blocks of a >= b > 0, which
+ * have an and bn blocks without leading zeros, as long as the quotients
+ * provably match those of a and b themselves (Knuth's Algorithm L), and
+ * leaves the accumulated cofactors in f. If minBits is nonnegative, also
+ * stops before a remainder could fall below 2^minBits; b must be at least
+ * that. If jacobi is given, it follows the quotients, and the step also
+ * stops where it cannot. Returns false if not even one quotient could be
+ * determined, as happens when a is much longer than b.
+ */
+bool lehmerCofactors(LehmerCofactors &f, const Blk *a, Index an,
+        const Blk *b, Index bn, long minBits, JacobiState *jacobi = NULL);
+
+/* Applies cofactors from lehmerCofactors to a and b in one pass, in place.
+ * b must have room for an blocks. Updates an and bn.
+ */
+void lehmerApply(const LehmerCofactors &f, Blk *a, Index &an, Blk *b,
+        Index &bn);
+
+/* Both of the above, without a bound; this takes about a block off each of
+ * a and b. a >= b still holds afterwards, and b may become zero. Returns
+ * false, changing nothing, if no quotient could be determined; a division
+ * step is then due.
+ */
+bool lehmerStep(Blk *a, Index &an, Blk *b, Index &bn);
+#endif
+
+}
+
+#endif
@@ -0,0 +1,449 @@
+#include "BlockArithmetic.h"
+
+// Division kernels behind BigUnsigned::divideWithRemainder.
+
+namespace BlockArithmetic {
+
+/* Knuth's Algorithm D (TAOCP vol. 2, 4.3.1). Each quotient block is first
+ * estimated from the top two blocks of the current remainder and the top
+ * block of d; the next block of d then corrects the estimate at most twice,
+ * which leaves it at most one too large, and the rare remaining excess is
+ * caught by adding d back.
+ */
+void divideSchoolbook(Blk *q, Blk *u, Index un, const Blk *d, Index dn) {
+    const Blk d1 = d[dn - 1];
+    if (dn == 1) {
+        // Short division, one block at a time
+        Blk r = u[un], v = reciprocalBlock(d1);
+        for (Index i = un; i > 0; --i)
+            q[i - 1] = divBlockPreinv(r, u[i - 1], d1, v, r);
+        u[0] = r;
+        return;
+    }
+
+    const Blk d2 = d[dn - 2];
+    for (Index j = un - dn + 1; j > 0; ) {
+        --j;
+        Blk *uj = u + j;
+        Blk top = uj[dn], qhat, rhat;
+        bool rhatOverflow = false;
+        if (top == d1) {
+            // The estimate would not fit in a block; B - 1 is an upper bound
+            qhat = ~Blk(0);
+            rhat = uj[dn - 1] + d1;
+            rhatOverflow = (rhat < d1);
+        } else
+            qhat = divBlock(top, uj[dn - 1], d1, rhat);
+        while (!rhatOverflow) {
+            // Is qhat d2 > rhat B + uj[dn - 2]?
+            Blk hi, lo = mulBlock(qhat, d2, hi);
+            if (hi < rhat || (hi == rhat && lo <= uj[dn - 2]))
+                break;
+            --qhat;
+            rhat += d1;
+            rhatOverflow = (rhat < d1);
+        }
+
+        // Multiply and subtract; add back if qhat was still one too large
+        Blk borrow = subMulBlock(uj, d, dn, qhat);
+        if (top < borrow) {
+            --qhat;
+            Blk carry = addBlocks(uj, uj, d, dn);
+            top += carry;
+        }
+        uj[dn] = top - borrow;
+        q[j] = qhat;
+    }
+}
+
+namespace {
+
+inline bool useBurnikelZiegler(Index n) {
+    return n >= BigUnsigned::burnikelZieglerThreshold && n >= 2;
+}
+
+/* One recursive step of Burnikel-Ziegler division, in the form of Brent and
+ * Zimmermann's RecursiveDivRem (Modern Computer Arithmetic, 1.4.3). Divides
+ * the n + m blocks of a by the n blocks of d, m <= n, leaving the m low
+ * quotient blocks in q and the remainder in a[0, n). Returns the quotient's
+ * top block, 0 or 1: the top n blocks of a may be as large as d, which the
+ * recursion needs since dividing by a truncated d can overshoot by one.
+ *
+ * With k = m / 2 and d = d1 B^k + d0, the top half of the quotient comes from
+ * dividing a by d1 alone, after which the remainder is corrected by
+ * subtracting that partial quotient times d0 and adding d back while the
+ * result is negative. The low half is done the same way on what is left.
+ */
+Blk divideRecursive(Blk *q, Blk *a, Index n, Index m, const Blk *d) {
+    Blk qh = 0;
+    if (compareBlocks(a + m, d, n) >= 0) {
+        subBlocks(a + m, a + m, d, n);
+        qh = 1;
+    }
+    if (!useBurnikelZiegler(m)) {
+        divideSchoolbook(q, a, n + m - 1, d, n);
+        return qh;
+    }
+
+    Index k = m / 2, h = m - k;
+    NumberlikeArray<Blk> product(m);
+    Blk *p = product.blk;
+    NumberlikeArray<Blk> ws(multiplyScratchSize(h, k));
+
+    // Top h quotient blocks from a[2k, n + m) / d1
+    Blk q1h = divideRecursive(q + k, a + 2 * k, n - k, h, d + k);
+    multiplyBlocks(p, q + k, h, d, k, ws.blk);
+    // The true remainder, a[0, n + k) less p B^k, may be negative by a few d
+    Blk neg = q1h ? addBlocks(p + h, p + h, d, k) : 0;
+    neg += subBlocks(a + k, a + k, p, m);
+    if (n > m)
+        neg = subBlock(a + k + m, a + k + m, n - m, neg);
+    while (neg != 0) {
+        q1h -= subBlock(q + k, q + k, h, 1);
+        neg -= addBlocks(a + k, a + k, d, n);
+    }
+    qh += q1h;
+
+    // Low k quotient blocks from a[k, n + k) / d1
+    Blk q0h = divideRecursive(q, a + k, n - k, k, d + k);
+    multiplyBlocks(p, q, k, d, k, ws.blk);
+    neg = q0h ? addBlocks(p + k, p + k, d, k) : 0;
+    neg += subBlocks(a, a, p, 2 * k);
+    if (n > 2 * k)
+        neg = subBlock(a + 2 * k, a + 2 * k, n - 2 * k, neg);
+    qh += addBlock(q + k, q + k, h, q0h);
+    while (neg != 0) {
+        qh -= subBlock(q, q, m, 1);
+        neg -= addBlocks(a, a, d, n);
+    }
+    return qh;
+}
+
+}
+
+/* Splits the quotient into chunks of at most dn blocks, each found by one
+ * recursive division whose remainder becomes the top of the next chunk's
+ * dividend.
+ */
+void divideBurnikelZiegler(Blk *q, Blk *u, Index un, const Blk *d, Index dn) {
+    Index qn = un - dn + 1;
+    Index m = qn % dn;
+    if (m == 0)
+        m = dn;
+    for (Index j = qn - m; ; j -= dn) {
+        divideRecursive(q + j, u + j, dn, m, d);
+        if (j == 0)
+            break;
+        m = dn;
+    }
+}
+
+namespace {
+
+inline bool useNewton(Index n) {
+    return n >= BigUnsigned::newtonThreshold && n >= 8;
+}
+
+/* Products whose result is known to be small in absolute value only need
+ * computing modulo B^len - 1 for some len a little above that size, which
+ * the transform does at half the length of the full product. Below the
+ * transform's range the full product is folded instead. cyclicLength(n) is
+ * the len to use for results of n blocks.
+ */
+Index cyclicLength(Index n) {
+#ifdef BLOCKARITHMETIC_HAVE_NTT
+    if (n >= BigUnsigned::nttThreshold)
+        return nttCyclicLength(n);
+#endif
+    return n;
+}
+
+/* r[0, len) = a * b mod (B^len - 1), where an >= bn and an <= len */
+void multiplyCyclic(Blk *r, const Blk *a, Index an, const Blk *b, Index bn,
+        Index len) {
+#ifdef BLOCKARITHMETIC_HAVE_NTT
+    if (len >= BigUnsigned::nttThreshold && (len & (len - 1)) == 0) {
+        multiplyNttCyclic(r, a, an, b, bn, len);
+        return;
+    }
+#endif
+    Index pn = an + bn;
+    NumberlikeArray<Blk> p(pn);
+    NumberlikeArray<Blk> ws(multiplyScratchSize(an, bn));
+    multiplyBlocks(p.blk, a, an, b, bn, ws.blk);
+    if (pn <= len) {
+        copyBlocks(r, p.blk, pn);
+        zeroBlocks(r + pn, len - pn);
+        return;
+    }
+    copyBlocks(r, p.blk, len);
+    Blk carry = addBlocks(r, r, p.blk + len, pn - len);
+    carry = addBlock(r + (pn - len), r + (pn - len), len - (pn - len), carry);
+    // B^len is 1 modulo B^len - 1
+    while (carry != 0)
+        carry = addBlock(r, r, len, carry);
+}
+
+/* Turns the len blocks of r, a residue modulo B^len - 1 of some value far
+ * below B^len / 2 in absolute value, into that value in two's complement
+ * modulo B^len.
+ */
+void signCyclic(Blk *r, Index len) {
+    if (r[len - 1] >> (N - 1))
+        addBlock(r, r, len, 1);
+}
+
+/* Sets the k + 1 blocks of x to within 2 of floor((B^2k - 1) / v), for a
+ * k-block v with its top bit set.
+ *
+ * Short reciprocals are found by division. Longer ones come from the
+ * reciprocal xh of v's top h = k / 2 + 1 blocks, scaled up to xh B^(k-h), by
+ * one Newton step x = xh B^(k-h) + xh e / B^2h with e = B^(k+h) - v xh. The
+ * scaled xh has a relative error below 3 / B^h, which the step squares to
+ * well under one unit, so x is off only by the truncations.
+ */
+void approximateReciprocal(Blk *x, const Blk *v, Index k) {
+    if (!useNewton(k)) {
+        NumberlikeArray<Blk> u(2 * k + 1);
+        for (Index i = 0; i < 2 * k; ++i)
+            u.blk[i] = ~Blk(0);
+        u.blk[2 * k] = 0;
+        if (useBurnikelZiegler(k))
+            divideBurnikelZiegler(x, u.blk, 2 * k, v, k);
+        else
+            divideSchoolbook(x, u.blk, 2 * k, v, k);
+        return;
+    }
+
+    Index h = k / 2 + 1;
+    NumberlikeArray<Blk> xh(h + 1);
+    approximateReciprocal(xh.blk, v + (k - h), h);
+
+    // e = B^(k+h) - v xh is small, |e| < 3 B^k, so it is found modulo
+    // B^len - 1 as B^((k+h) mod len) + (B^len - 1 - v xh)
+    Index len = cyclicLength(k + 2);
+    NumberlikeArray<Blk> e(len);
+    multiplyCyclic(e.blk, v, k, xh.blk, h + 1, len);
+    for (Index i = 0; i < len; ++i)
+        e.blk[i] = ~e.blk[i];
+    Index top = (k + h) % len;
+    Blk carry = addBlock(e.blk + top, e.blk + top, len - top, 1);
+    while (carry != 0)
+        carry = addBlock(e.blk, e.blk, len, carry);
+    signCyclic(e.blk, len);
+    bool negative = (e.blk[len - 1] >> (N - 1)) != 0;
+    if (negative) {
+        for (Index i = 0; i < len; ++i)
+            e.blk[i] = ~e.blk[i];
+        addBlock(e.blk, e.blk, len, 1);
+    }
+    Index en = len;
+    while (en > 0 && e.blk[en - 1] == 0)
+        --en;
+
+    // x = xh B^(k-h) +/- floor(xh |e| / B^2h). Blocks of e below B^(h-1)
+    // move the result by less than one unit, so they are left out.
+    zeroBlocks(x, k - h);
+    copyBlocks(x + (k - h), xh.blk, h + 1);
+    if (en <= h)
+        return;
+    const Blk *et = e.blk + (h - 1);
+    Index etn = en - (h - 1);
+    NumberlikeArray<Blk> t(h + 1 + etn), ws;
+    if (etn >= h + 1) {
+        ws.allocate(multiplyScratchSize(etn, h + 1));
+        multiplyBlocks(t.blk, et, etn, xh.blk, h + 1, ws.blk);
+    } else {
+        ws.allocate(multiplyScratchSize(h + 1, etn));
+        multiplyBlocks(t.blk, xh.blk, h + 1, et, etn, ws.blk);
+    }
+    Blk *delta = t.blk + (h + 1);
+    Index dl = etn;
+    if (negative)
+        subBlock(x + dl, x + dl, k + 1 - dl, subBlocks(x, x, delta, dl));
+    else
+        addBlock(x + dl, x + dl, k + 1 - dl, addBlocks(x, x, delta, dl));
+}
+
+/* One quotient chunk of divideNewton: un - dn + 1 <= dn */
+void divideByReciprocal(Blk *q, Blk *u, Index un, const Blk *d, Index dn) {
+    Index m = un - dn + 1;
+    // Only the top k blocks of d are needed to get within a few units of
+    // the m-block quotient
+    Index k = (m + 1 < dn) ? m + 1 : dn;
+    NumberlikeArray<Blk> x(k + 1);
+    approximateReciprocal(x.blk, d + (dn - k), k);
+
+    // q = floor(u' x / B^2k), u' being the top m + 1 blocks of u: the
+    // blocks below them move the result by less than one unit
+    const Blk *us = u + (dn - 1);
+    NumberlikeArray<Blk> t(k + m + 2);
+    NumberlikeArray<Blk> ws(multiplyScratchSize(k + 1, m + 1));
+    multiplyBlocks(t.blk, x.blk, k + 1, us, m + 1, ws.blk);
+    if (t.blk[k + m + 1] != 0)
+        for (Index i = 0; i < m; ++i)
+            q[i] = ~Blk(0);
+    else
+        copyBlocks(q, t.blk + (k + 1), m);
+
+    // The remainder u - q d is within a few d of 0, so it too is found
+    // modulo B^len - 1, from u folded down to len blocks
+    Index len = cyclicLength(dn + 2);
+    NumberlikeArray<Blk> r(len), qd(len);
+    multiplyCyclic(qd.blk, d, dn, q, m, len);
+    Index un1 = m + dn;
+    if (un1 <= len) {
+        copyBlocks(r.blk, u, un1);
+        zeroBlocks(r.blk + un1, len - un1);
+    } else {
+        copyBlocks(r.blk, u, len);
+        Blk carry = addBlocks(r.blk, r.blk, u + len, un1 - len);
+        carry = addBlock(r.blk + (un1 - len), r.blk + (un1 - len),
+                len - (un1 - len), carry);
+        while (carry != 0)
+            carry = addBlock(r.blk, r.blk, len, carry);
+    }
+    // Subtracting B^len is one too many modulo B^len - 1
+    if (subBlocks(r.blk, r.blk, qd.blk, len))
+        subBlock(r.blk, r.blk, len, 1);
+    signCyclic(r.blk, len);
+
+    // The final few corrections
+    while (r.blk[len - 1] >> (N - 1)) {
+        subBlock(q, q, m, 1);
+        Blk carry = addBlocks(r.blk, r.blk, d, dn);
+        addBlock(r.blk + dn, r.blk + dn, len - dn, carry);
+    }
+    for (;;) {
+        Index i = len;
+        while (i > dn && r.blk[i - 1] == 0)
+            --i;
+        if (i == dn && compareBlocks(r.blk, d, dn) < 0)
+            break;
+        addBlock(q, q, m, 1);
+        Blk b = subBlocks(r.blk, r.blk, d, dn);
+        subBlock(r.blk + dn, r.blk + dn, len - dn, b);
+    }
+    copyBlocks(u, r.blk, dn);
+}
+
+}
+
+/* Quotient chunks of at most dn blocks, as in divideBurnikelZiegler */
+void divideNewton(Blk *q, Blk *u, Index un, const Blk *d, Index dn) {
+    Index qn = un - dn + 1;
+    Index m = qn % dn;
+    if (m == 0)
+        m = dn;
+    for (Index j = qn - m; ; j -= dn) {
+        divideByReciprocal(q + j, u + j, dn + m - 1, d, dn);
+        if (j == 0)
+            break;
+        m = dn;
+    }
+}
+
+void divideBlocks(Blk *q, Blk *u, Index un, const Blk *d, Index dn) {
+    if (useNewton(dn) && useNewton(un - dn + 1))
+        divideNewton(q, u, un, d, dn);
+    else if (useBurnikelZiegler(dn) && useBurnikelZiegler(un - dn + 1))
+        divideBurnikelZiegler(q, u, un, d, dn);
+    else
+        divideSchoolbook(q, u, un, d, dn);
+}
+
+namespace {
+
+/* Short division by an arbitrary block d = dn >> s, where dn has its top bit
+ * set and v = reciprocalBlock(dn). The dividend's bits are shifted left by s
+ * as they are read, so every step can use the reciprocal; the remainder comes
+ * out shifted by the same amount. The quotient is stored only if asked for.
+ */
+template <bool storeQuotient>
+Blk shortDivide(Blk *q, const Blk *a, Index n, Blk dn, Blk v, unsigned int s) {
+    Blk r = 0, qi;
+    if (s == 0) {
+        for (Index i = n; i > 0; --i) {
+            qi = divBlockPreinv(r, a[i - 1], dn, v, r);
+            if (storeQuotient)
+                q[i - 1] = qi;
+        }
+        return r;
+    }
+    Blk next = a[n - 1];
+    r = next >> (N - s);
+    for (Index i = n - 1; i > 0; --i) {
+        Blk x = next;
+        next = a[i - 1];
+        qi = divBlockPreinv(r, (x << s) | (next >> (N - s)), dn, v, r);
+        if (storeQuotient)
+            q[i] = qi;
+    }
+    qi = divBlockPreinv(r, next << s, dn, v, r);
+    if (storeQuotient)
+        q[0] = qi;
+    return r >> s;
+}
+
+/* hi B + lo += a b. The caller guarantees the sum fits in two blocks. */
+inline void addProduct(Blk &hi, Blk &lo, Blk a, Blk b) {
+    Blk ph, pl = mulBlock(a, b, ph);
+    lo += pl;
+    hi += ph + (lo < pl);
+}
+
+}
+
+Blk divideBlocksByBlock(Blk *q, const Blk *a, Index n, Blk d) {
+    unsigned int s = countLeadingZeros(d);
+    return shortDivide<true>(q, a, n, d << s, reciprocalBlock(d << s), s);
+}
+
+/* When d < B / 8 the remainder does not need a reduction per block at all.
+ * With c_k = B^k mod d, four blocks at a time are folded into a two-block
+ * running value r1 B + r0 by
+ *     r1 B^5 + r0 B^4 + x3 B^3 + ... + x0 = r1 c5 + r0 c4 + x3 c3 + ... + x0
+ * modulo d, which stays below 5 B d + B <= B^2. The products are independent
+ * of each other, so the loop runs at multiplier throughput rather than at
+ * the latency of one division per block; only the final value is reduced
+ * (GMP's mod_1s_4p). Computing the c_k costs about as much as reducing twenty
+ * blocks the plain way, so shorter dividends skip it.
+ */
+Blk remainderBlocksByBlock(const Blk *a, Index n, Blk d) {
+    unsigned int s = countLeadingZeros(d);
+    Blk dn = d << s, v = reciprocalBlock(dn), c[6];
+    if (n < 20 || s < 3)
+        return shortDivide<false>(0, a, n, dn, v, s);
+
+    // c[k] = B^k mod d, computed shifted by s
+    c[0] = Blk(1) << s;
+    for (unsigned int k = 1; k < 6; ++k)
+        divBlockPreinv(c[k - 1], 0, dn, v, c[k]);
+    for (unsigned int k = 1; k < 6; ++k)
+        c[k] >>= s;
+
+    Blk r1 = 0, r0 = 0;
+    Index i = n;
+    for (; i >= 4; i -= 4) {
+        Blk hi = 0, lo = a[i - 4];
+        addProduct(hi, lo, a[i - 3], c[1]);
+        addProduct(hi, lo, a[i - 2], c[2]);
+        addProduct(hi, lo, a[i - 1], c[3]);
+        addProduct(hi, lo, r0, c[4]);
+        addProduct(hi, lo, r1, c[5]);
+        r1 = hi;
+        r0 = lo;
+    }
+    // Fold in the leftover low blocks one at a time
+    for (; i > 0; --i) {
+        Blk hi = 0, lo = a[i - 1];
+        addProduct(hi, lo, r0, c[1]);
+        addProduct(hi, lo, r1, c[2]);
+        r1 = hi;
+        r0 = lo;
+    }
+    Blk r[2] = {r0, r1};
+    return shortDivide<false>(0, r, 2, dn, v, s);
+}
+
+}
@@ -0,0 +1,444 @@
+#include "BlockArithmetic.h"
+
+// Greatest common divisor kernels behind gcd().
+
+namespace BlockArithmetic {
+
+Blk gcdBlock(Blk a, Blk b) {
+    if (a == 0)
+        return b;
+    if (b == 0)
+        return a;
+    // Common factors of two, then odd a and b
+    unsigned int k = countTrailingZeros(a | b);
+    a >>= countTrailingZeros(a);
+    do {
+        b >>= countTrailingZeros(b);
+        if (a > b) {
+            Blk t = a;
+            a = b;
+            b = t;
+        }
+        b -= a;
+    } while (b != 0);
+    return a << k;
+}
+
+namespace {
+
+/* The number of trailing zero bits of a nonzero array */
+Index trailingZeroBits(const Blk *x) {
+    Index i = 0;
+    while (x[i] == 0)
+        ++i;
+    return i * N + countTrailingZeros(x[i]);
+}
+
+/* Shifts the n blocks of a nonzero x right by z <= trailingZeroBits(x) bits,
+ * in place, and returns the new length
+ */
+Index shiftDown(Blk *x, Index n, Index z) {
+    Index kb = z / N;
+    unsigned int s = z % N;
+    n -= kb;
+    if (s == 0) {
+        if (kb > 0)
+            copyBlocks(x, x + kb, n);
+    } else {
+        for (Index i = 0; i + 1 < n; ++i)
+            x[i] = (x[i + kb] >> s) | (x[i + kb + 1] << (N - s));
+        x[n - 1] = x[n - 1 + kb] >> s;
+    }
+    return (x[n - 1] == 0) ? n - 1 : n;
+}
+
+/* r = x << z, where x has xn blocks and r may equal x; returns the length.
+ * Works from the top down, so the shifted copy never overwrites blocks of
+ * x still to be read.
+ */
+Index shiftUp(Blk *r, const Blk *x, Index xn, Index z) {
+    Index kb = z / N;
+    unsigned int s = z % N;
+    Index rn = xn + kb;
+    if (s == 0) {
+        for (Index i = xn; i > 0; --i)
+            r[i - 1 + kb] = x[i - 1];
+    } else {
+        Blk out = x[xn - 1] >> (N - s);
+        if (out != 0)
+            r[rn++] = out;
+        for (Index i = xn - 1; i > 0; --i)
+            r[i + kb] = (x[i] << s) | (x[i - 1] >> (N - s));
+        r[kb] = x[0] << s;
+    }
+    zeroBlocks(r, kb);
+    return rn;
+}
+
+}
+
+Index gcdBinary(Blk *a, Index an, Blk *b, Index bn) {
+    // Set the common factors of two aside, then keep both numbers odd
+    Index za = trailingZeroBits(a), zb = trailingZeroBits(b);
+    Index k = (za < zb) ? za : zb;
+    Blk *x = a, *y = b;
+    Index xn = shiftDown(a, an, za), yn = shiftDown(b, bn, zb);
+    for (;;) {
+        if (xn == 1 && yn == 1) {
+            x[0] = gcdBlock(x[0], y[0]);
+            break;
+        }
+        int c = (xn != yn) ? ((xn > yn) ? 1 : -1) : compareBlocks(x, y, xn);
+        if (c == 0)
+            break;
+        if (c < 0) {
+            Blk *t = x;
+            x = y;
+            y = t;
+            Index tn = xn;
+            xn = yn;
+            yn = tn;
+        }
+        // The difference of two odd numbers is even and, here, positive
+        Blk borrow = subBlocks(x, x, y, yn);
+        subBlock(x + yn, x + yn, xn - yn, borrow);
+        while (x[xn - 1] == 0)
+            --xn;
+        xn = shiftDown(x, xn, trailingZeroBits(x));
+    }
+    // The gcd divides both inputs, so it fits in a's space
+    if (k == 0 && x == a)
+        return xn;
+    return shiftUp(a, x, xn, k);
+}
+
+namespace {
+
+/* x = x / 2^z mod m, for x < m of n blocks with room for one more; -1/m mod
+ * B is mInv. As in Montgomery reduction, adding the right multiple of m
+ * below 2^k m clears the low k bits, after which the shift leaves x < m.
+ */
+void halveMod(Blk *x, const Blk *m, Index n, Blk mInv, Index z) {
+    while (z > 0) {
+        unsigned int k = (z < N) ? unsigned(z) : N - 1;
+        Blk t = (x[0] * mInv) & ((Blk(1) << k) - 1);
+        x[n] = addMulBlock(x, m, n, t);
+        shiftRightBlocks(x, x, n + 1, k);
+        z -= k;
+    }
+}
+
+/* x = x - y mod m, all of n blocks */
+void subtractMod(Blk *x, const Blk *y, const Blk *m, Index n) {
+    if (subBlocks(x, x, y, n))
+        addBlocks(x, x, m, n);
+}
+
+}
+
+bool inverseBinary(Blk *x, const Blk *a, Index an, const Blk *m, Index n) {
+    NumberlikeArray<Blk> ws(4 * n + 2);
+    Blk *u = ws.blk, *v = u + n, *x1 = v + n, *x2 = x1 + n + 1;
+    copyBlocks(u, a, an);
+    copyBlocks(v, m, n);
+    zeroBlocks(x1, n);
+    zeroBlocks(x2, n);
+    x1[0] = 1;
+    Index un = an, vn = n;
+    Blk mInv = 0 - inverseBlockModBase(m[0]);
+
+    // x1 a = u and x2 a = v (mod m) throughout, as in gcdBinary, with v odd
+    // but for a moment after v -= u
+    while (un > 0) {
+        Index z = trailingZeroBits(u);
+        if (z > 0) {
+            un = shiftDown(u, un, z);
+            halveMod(x1, m, n, mInv, z);
+        }
+        z = trailingZeroBits(v);
+        if (z > 0) {
+            vn = shiftDown(v, vn, z);
+            halveMod(x2, m, n, mInv, z);
+        }
+        int c = (un != vn) ? ((un > vn) ? 1 : -1) : compareBlocks(u, v, un);
+        if (c >= 0) {
+            Blk borrow = subBlocks(u, u, v, vn);
+            subBlock(u + vn, u + vn, un - vn, borrow);
+            while (un > 0 && u[un - 1] == 0)
+                --un;
+            subtractMod(x1, x2, m, n);
+        } else {
+            Blk borrow = subBlocks(v, v, u, un);
+            subBlock(v + un, v + un, vn - un, borrow);
+            while (v[vn - 1] == 0)
+                --vn;
+            subtractMod(x2, x1, m, n);
+        }
+    }
+    // v is now the gcd
+    if (vn != 1 || v[0] != 1)
+        return false;
+    copyBlocks(x, x2, n);
+    return true;
+}
+
+namespace {
+
+/* (2/v) = -1 exactly when v = 3 or 5 (mod 8) */
+inline bool twoIsNonResidue(Blk v) {
+    return ((v & 7) == 3) || ((v & 7) == 5);
+}
+
+/* Reciprocity: (u/v) = -(v/u) exactly when u = v = 3 (mod 4) */
+inline bool reciprocityFlips(Blk u, Blk v) {
+    return (u & 3) == 3 && (v & 3) == 3;
+}
+
+/* (a/b) for single blocks, b odd */
+int jacobiBlock(Blk a, Blk b) {
+    int s = 1;
+    a %= b;
+    while (a != 0) {
+        unsigned int z = countTrailingZeros(a);
+        a >>= z;
+        if ((z & 1) && twoIsNonResidue(b))
+            s = -s;
+        if (a < b) {
+            if (reciprocityFlips(a, b))
+                s = -s;
+            Blk t = a;
+            a = b;
+            b = t;
+        }
+        a -= b;
+    }
+    return (b == 1) ? s : 0;
+}
+
+}
+
+int jacobiBinary(Blk *a, Index an, Blk *b, Index bn) {
+    int s = 1;
+    for (;;) {
+        if (an == 0)
+            return (bn == 1 && b[0] == 1) ? s : 0;
+        if (an == 1 && bn == 1)
+            return s * jacobiBlock(a[0], b[0]);
+        Index z = trailingZeroBits(a);
+        if ((z & 1) && twoIsNonResidue(b[0]))
+            s = -s;
+        an = shiftDown(a, an, z);
+        int c = (an != bn) ? ((an > bn) ? 1 : -1) : compareBlocks(a, b, an);
+        if (c < 0) {
+            if (reciprocityFlips(a[0], b[0]))
+                s = -s;
+            Blk *t = a;
+            a = b;
+            b = t;
+            Index tn = an;
+            an = bn;
+            bn = tn;
+        }
+        // Both odd, so the difference is even
+        Blk borrow = subBlocks(a, a, b, bn);
+        subBlock(a + bn, a + bn, an - bn, borrow);
+        while (an > 0 && a[an - 1] == 0)
+            --an;
+    }
+}
+
+void JacobiState::advance(Blk r, Index e, Blk w) {
+    if (denominatorIsX) {
+        if (y & 1) {
+            // Swap to (x/y) before y reduces x
+            if (reciprocityFlips(x, y))
+                sign = -sign;
+        } else {
+            // (2^e w / x) = (2^e w / r) times these, since x = r (mod w)
+            if ((e & 1) && twoIsNonResidue(x) != twoIsNonResidue(r))
+                sign = -sign;
+            if (reciprocityFlips(w, x) != reciprocityFlips(w, r))
+                sign = -sign;
+            denominatorIsX = false;
+            x = y;
+            y = r;
+            return;
+        }
+    }
+    // The denominator y becomes the new x
+    denominatorIsX = true;
+    x = y;
+    y = r;
+}
+
+bool JacobiState::step(Blk q) {
+    Index e = 0;
+    Blk w = 0;
+    if (denominatorIsX && (y & 1) == 0) {
+        // w's low two bits must still be in the block
+        if (y == 0 || (e = countTrailingZeros(y)) > N - 2)
+            return false;
+        w = y >> e;
+    }
+    advance(x - q * y, e, w);
+    return true;
+}
+
+#ifdef BLOCKARITHMETIC_HAVE_DBLK
+
+namespace {
+
+/* The bits of the xn blocks of x from bit z up, as a double block; bits
+ * below bit 0 count as zero when z is negative. The caller ensures there
+ * are no more than 2N of them.
+ */
+DBlk leadingBits(const Blk *x, Index xn, long z) {
+    if (z < 0) {
+        DBlk v = x[0];
+        if (xn > 1)
+            v |= DBlk(x[1]) << N;
+        return v << -z;
+    }
+    Index kb = Index(z / N);
+    unsigned int s = z % N;
+    Blk w0 = x[kb];
+    Blk w1 = (kb + 1 < xn) ? x[kb + 1] : 0;
+    Blk w2 = (kb + 2 < xn) ? x[kb + 2] : 0;
+    if (s == 0)
+        return (DBlk(w1) << N) | w0;
+    Blk lo = (w0 >> s) | (w1 << (N - s)), hi = (w1 >> s) | (w2 << (N - s));
+    return (DBlk(hi) << N) | lo;
+}
+
+/* One row of a Lehmer step: u P - v M, where the result is known to be
+ * nonnegative. Carries of the positive and negative parts are kept apart.
+ */
+struct CombineRow {
+    Blk u, v;
+    bool aPositive;
+    Blk plusCarry, minusCarry, borrow;
+
+    /* The row A a + B b, one of A and B positive and the other not */
+    CombineRow(SDBlk A, SDBlk B) : plusCarry(0), minusCarry(0), borrow(0) {
+        aPositive = (A > 0);
+        u = Blk(aPositive ? A : B);
+        v = Blk(aPositive ? -B : -A);
+    }
+
+    Blk next(Blk ai, Blk bi) {
+        DBlk p = DBlk(u) * (aPositive ? ai : bi) + plusCarry;
+        DBlk m = DBlk(v) * (aPositive ? bi : ai) + minusCarry;
+        Blk pl = Blk(p), ml = Blk(m), d = pl - ml;
+        Blk r = d - borrow;
+        borrow = (pl < ml) | (d < borrow);
+        plusCarry = Blk(p >> N);
+        minusCarry = Blk(m >> N);
+        return r;
+    }
+};
+
+}
+
+bool lehmerCofactors(LehmerCofactors &f, const Blk *a, Index an,
+        const Blk *b, Index bn, long minBits, JacobiState *jacobi) {
+    // The top 2N - 5 bits of a and the bits of b at the same positions, so
+    // that eight times a sum below still fits in a signed double block
+    long bits = long(an) * N - countLeadingZeros(a[an - 1]);
+    long z = bits - long(2 * N - 5);
+    SDBlk x = SDBlk(leadingBits(a, an, z));
+    SDBlk y = (z < 0 || Index(z / N) < bn) ? SDBlk(leadingBits(b, bn, z)) : 0;
+
+    // A remainder of a and b is 2^z times the matching one of x and y, give
+    // or take (|C| + |D|) 2^z, so it is known to reach 2^minBits when that
+    // one reaches 2^(minBits - z) + |C| + |D|
+    SDBlk least = 0;
+    if (minBits >= 0) {
+        long e = minBits - z;
+        if (e >= long(2 * N - 6))
+            return false;
+        least = (e > 0) ? SDBlk(1) << e : 1;
+    }
+
+    // Knuth's Algorithm L: Euclid on x + A / y + C and on x + B / y + D,
+    // which bracket the true ratio, for as long as the quotients agree.
+    // The cofactors stay below 2^(N - 1) so that they fit in blocks.
+    const SDBlk limit = SDBlk(1) << (N - 1);
+    SDBlk A = 1, B = 0, C = 0, D = 1;
+    unsigned int quotients = 0;
+    for (;;) {
+        SDBlk yc = y + C, yd = y + D;
+        if (yc <= 0 || yd <= 0)
+            break;
+        // Most quotients are small, and a few subtractions beat a division
+        // of double blocks
+        SDBlk xa = x + A, xb = x + B, q = 1, r = xa - yc;
+        if (r < 0)
+            break;
+        while (r >= yc && q < 8) {
+            r -= yc;
+            ++q;
+        }
+        if (r >= yc) {
+            q = xa / yc;
+            if (q != xb / yd)
+                break;
+        } else {
+            r = xb - q * yd;
+            if (r < 0 || r >= yd)
+                break;
+        }
+        SDBlk nc = A - q * C, nd = B - q * D;
+        if (nc >= limit || -nc >= limit || nd >= limit || -nd >= limit)
+            break;
+        SDBlk t = x - q * y;
+        if (least != 0
+                && t - (nc < 0 ? -nc : nc) - (nd < 0 ? -nd : nd) < least)
+            break;
+        if (jacobi && !jacobi->step(Blk(q)))
+            break;
+        A = C;
+        C = nc;
+        B = D;
+        D = nd;
+        x = y;
+        y = t;
+        ++quotients;
+    }
+    if (quotients == 0)
+        return false;
+    f.A = A;
+    f.B = B;
+    f.C = C;
+    f.D = D;
+    f.quotients = quotients;
+    return true;
+}
+
+void lehmerApply(const LehmerCofactors &f, Blk *a, Index &an, Blk *b,
+        Index &bn) {
+    // a, b = A a + B b, C a + D b; the second row only exists up to bn
+    // blocks of b, but a's blocks reach further
+    CombineRow row1(f.A, f.B), row2(f.C, f.D);
+    for (Index i = 0; i < an; ++i) {
+        Blk ai = a[i], bi = (i < bn) ? b[i] : 0;
+        a[i] = row1.next(ai, bi);
+        b[i] = row2.next(ai, bi);
+    }
+    while (an > 0 && a[an - 1] == 0)
+        --an;
+    bn = an;
+    while (bn > 0 && b[bn - 1] == 0)
+        --bn;
+}
+
+bool lehmerStep(Blk *a, Index &an, Blk *b, Index &bn) {
+    LehmerCofactors f;
+    if (!lehmerCofactors(f, a, an, b, bn, -1))
+        return false;
+    lehmerApply(f, a, an, b, bn);
+    return true;
+}
+
+#endif
+
+}
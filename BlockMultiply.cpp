@@ -0,0 +1,548 @@
+#include "BlockArithmetic.h"
+
+// Multiplication kernels behind BigUnsigned::multiply.
+
+namespace BlockArithmetic {
+
+void multiplySchoolbook(Blk *r, const Blk *a, Index an, const Blk *b, Index bn) {
+    // The first row initializes r, the others accumulate into it
+    r[an] = mulBlocksByBlock(r, a, an, b[0]);
+    for (Index j = 1; j < bn; ++j)
+        r[an + j] = addMulBlock(r + j, a, an, b[j]);
+}
+
+/* Each cross product a_i a_j (i < j) appears twice in a^2, so sum them once,
+ * double the sum with a shift and add the squares a_i^2 on the diagonal.
+ */
+void squareSchoolbook(Blk *r, const Blk *a, Index n) {
+    r[0] = 0;
+    r[2 * n - 1] = 0;
+    if (n > 1) {
+        // Row i covers r[2i + 1, i + n] and is the first to reach r[i + n]
+        r[n] = mulBlocksByBlock(r + 1, a + 1, n - 1, a[0]);
+        for (Index i = 1; i + 1 < n; ++i)
+            r[i + n] = addMulBlock(r + 2 * i + 1, a + i + 1, n - i - 1, a[i]);
+        shiftLeftBlocks(r, r, 2 * n, 1);
+    }
+    Blk carry = 0, hi, lo;
+    for (Index i = 0; i < n; ++i) {
+        lo = mulBlock(a[i], a[i], hi);
+        lo += carry;
+        hi += (lo < carry);
+        Blk x = r[2 * i] + lo;
+        carry = (x < lo);
+        r[2 * i] = x;
+        x = r[2 * i + 1] + hi;
+        Blk c = (x < hi);
+        x += carry;
+        carry = c + (x < carry);
+        r[2 * i + 1] = x;
+    }
+}
+
+/* Stores |x - y| in r, where x has xn blocks, y has yn blocks and
+ * xn >= yn >= xn - 1; r gets xn blocks. Returns true if x < y.
+ */
+static bool absoluteDifference(Blk *r, const Blk *x, Index xn,
+        const Blk *y, Index yn) {
+    bool xLess;
+    if (xn > yn && x[yn] != 0)
+        xLess = false;
+    else
+        xLess = compareBlocks(x, y, yn) < 0;
+    if (xLess)
+        subBlocks(r, y, x, yn);
+    else {
+        Blk borrow = subBlocks(r, x, y, yn);
+        if (xn > yn)
+            r[yn] = x[yn] - borrow;
+    }
+    if (xLess && xn > yn)
+        r[yn] = 0;
+    return xLess;
+}
+
+/* Each algorithm needs a minimum number of pieces to split the operands
+ * into, whatever the thresholds say.
+ */
+static inline bool useKaratsuba(Index n) {
+    return n >= BigUnsigned::karatsubaThreshold && n >= 2;
+}
+static inline bool useKaratsubaSquare(Index n) {
+    return n >= BigUnsigned::karatsubaSquareThreshold && n >= 2;
+}
+static inline bool useToom3(Index n) {
+    return n >= BigUnsigned::toom3Threshold && n >= 7;
+}
+static inline bool useToom4(Index n) {
+    return n >= BigUnsigned::toom4Threshold && n >= 13;
+}
+/* Whether any of the balanced algorithms beats schoolbook at n, whichever
+ * tier comes in first
+ */
+static inline bool useSubquadratic(Index n) {
+    return useKaratsuba(n) || useToom3(n) || useToom4(n);
+}
+static inline bool useNtt(Index n) {
+#ifdef BLOCKARITHMETIC_HAVE_NTT
+    return n >= BigUnsigned::nttThreshold;
+#else
+    (void)n;
+    return false;
+#endif
+}
+
+/* Squares an n-block operand with whichever algorithm suits n. The Toom-Cook
+ * kernels recognize a squaring by a == b.
+ */
+static void squareBalanced(Blk *r, const Blk *a, Index n, Blk *ws) {
+    if (useToom4(n))
+        multiplyToom4(r, a, a, n);
+    else if (useToom3(n))
+        multiplyToom3(r, a, a, n);
+    else if (useKaratsubaSquare(n))
+        squareKaratsuba(r, a, n, ws);
+    else
+        squareSchoolbook(r, a, n);
+}
+
+/* Multiplies two n-block operands with whichever algorithm suits n */
+static void multiplyBalanced(Blk *r, const Blk *a, const Blk *b, Index n,
+        Blk *ws) {
+    if (a == b)
+        squareBalanced(r, a, n, ws);
+    else if (useToom4(n))
+        multiplyToom4(r, a, b, n);
+    else if (useToom3(n))
+        multiplyToom3(r, a, b, n);
+    else if (useKaratsuba(n))
+        multiplyKaratsuba(r, a, b, n, ws);
+    else
+        multiplySchoolbook(r, a, n, b, n);
+}
+
+/* Scratch for multiplyBalanced and squareBalanced; the Toom-Cook kernels
+ * bring their own
+ */
+static Index balancedScratchSize(Index n) {
+    if (useToom3(n) || useToom4(n))
+        return 0;
+    Index s1 = karatsubaScratchSize(n), s2 = karatsubaSquareScratchSize(n);
+    return (s1 > s2) ? s1 : s2;
+}
+
+/* Scratch for the pointwise products of a Toom-Cook split into k-block
+ * pieces with an s-block top piece. The evaluated pieces have k + 1 blocks,
+ * and the three sizes may fall on different sides of a crossover.
+ */
+static Index pieceScratchSize(Index k, Index s) {
+    Index s1 = balancedScratchSize(k + 1), s2 = balancedScratchSize(k);
+    Index s3 = balancedScratchSize(s);
+    if (s2 > s1)
+        s1 = s2;
+    return (s3 > s1) ? s3 : s1;
+}
+
+Index karatsubaScratchSize(Index n) {
+    if (!useKaratsuba(n))
+        return 0;
+    Index h2 = n - n / 2;
+    return 4 * h2 + karatsubaScratchSize(h2);
+}
+
+/* Karatsuba: with a = a1 B^h + a0 and b = b1 B^h + b0,
+ *   a b = a1 b1 B^2h + (a0 b0 + a1 b1 - (a1 - a0)(b1 - b0)) B^h + a0 b0.
+ * The two outer products go straight into r; the scratch area holds the
+ * differences, their product, and the recursion's own scratch.
+ */
+void multiplyKaratsuba(Blk *r, const Blk *a, const Blk *b, Index n, Blk *ws) {
+    Index h = n / 2, h2 = n - h;
+    Blk *da = ws, *db = ws + h2, *p = ws + 2 * h2, *sub = ws + 4 * h2;
+
+    // Differences of the halves and their product
+    bool aNeg = absoluteDifference(da, a + h, h2, a, h);
+    bool bNeg = absoluteDifference(db, b + h, h2, b, h);
+    multiplyBalanced(p, da, db, h2, sub);
+
+    // Outer products
+    multiplyBalanced(r, a, b, h, sub);
+    multiplyBalanced(r + 2 * h, a + h, b + h, h2, sub);
+
+    // Middle term: t = a0 b0 + a1 b1 -/+ p, kept in the space of da and db
+    Blk *t = ws;
+    Blk carry = addBlocks(t, r + 2 * h, r, 2 * h);
+    carry = addBlock(t + 2 * h, r + 4 * h, 2 * (h2 - h), carry);
+    if (aNeg == bNeg)
+        carry -= subBlocks(t, t, p, 2 * h2);
+    else
+        carry += addBlocks(t, t, p, 2 * h2);
+
+    // Add it in at B^h; the product fits in 2n blocks, so the carry dies out
+    carry += addBlocks(r + h, r + h, t, 2 * h2);
+    addBlock(r + h + 2 * h2, r + h + 2 * h2, h, carry);
+}
+
+/* Karatsuba squaring: the middle term is a0^2 + a1^2 - (a1 - a0)^2, and the
+ * last square needs no sign. The scratch layout matches multiplyKaratsuba.
+ */
+void squareKaratsuba(Blk *r, const Blk *a, Index n, Blk *ws) {
+    Index h = n / 2, h2 = n - h;
+    Blk *d = ws, *p = ws + 2 * h2, *sub = ws + 4 * h2;
+
+    absoluteDifference(d, a + h, h2, a, h);
+    squareBalanced(p, d, h2, sub);
+    squareBalanced(r, a, h, sub);
+    squareBalanced(r + 2 * h, a + h, h2, sub);
+
+    Blk *t = ws;
+    Blk carry = addBlocks(t, r + 2 * h, r, 2 * h);
+    carry = addBlock(t + 2 * h, r + 4 * h, 2 * (h2 - h), carry);
+    carry -= subBlocks(t, t, p, 2 * h2);
+
+    carry += addBlocks(r + h, r + h, t, 2 * h2);
+    addBlock(r + h + 2 * h2, r + h + 2 * h2, h, carry);
+}
+
+// TOOM-COOK
+
+/* Helpers for numbers of different lengths: r has rn blocks and a has an.
+ * When an > rn, the caller knows the extra blocks of a are zero.
+ */
+static void addInto(Blk *r, Index rn, const Blk *a, Index an) {
+    if (an > rn)
+        an = rn;
+    Blk carry = addBlocks(r, r, a, an);
+    addBlock(r + an, r + an, rn - an, carry);
+}
+static void subInto(Blk *r, Index rn, const Blk *a, Index an) {
+    if (an > rn)
+        an = rn;
+    Blk borrow = subBlocks(r, r, a, an);
+    subBlock(r + an, r + an, rn - an, borrow);
+}
+static void addMulInto(Blk *r, Index rn, const Blk *a, Index an, Blk m) {
+    Blk carry = addMulBlock(r, a, an, m);
+    addBlock(r + an, r + an, rn - an, carry);
+}
+static void subMulInto(Blk *r, Index rn, const Blk *a, Index an, Blk m) {
+    Blk borrow = subMulBlock(r, a, an, m);
+    subBlock(r + an, r + an, rn - an, borrow);
+}
+
+/* Divides a by an odd d in place, knowing that the division is exact. This
+ * multiplies by the inverse of d mod B instead of dividing (Jebelean).
+ */
+static void divideExactly(Blk *a, Index n, Blk d) {
+    // Newton's iteration doubles the correct low bits of the inverse
+    Blk inv = d;
+    for (unsigned int bits = 3; bits < N; bits *= 2)
+        inv *= 2 - d * inv;
+    Blk carry = 0, hi;
+    for (Index i = 0; i < n; ++i) {
+        Blk x = a[i], y = x - carry;
+        carry = (y > x);
+        Blk q = y * inv;
+        a[i] = q;
+        mulBlock(q, d, hi);
+        carry += hi;
+    }
+}
+
+/* Stores |x - y| in r, all three having n blocks; returns true if x < y */
+static bool signedDifference(Blk *r, const Blk *x, const Blk *y, Index n) {
+    if (compareBlocks(x, y, n) < 0) {
+        subBlocks(r, y, x, n);
+        return true;
+    }
+    subBlocks(r, x, y, n);
+    return false;
+}
+
+/* x = x + (neg ? -y : y) where the result is known to be nonnegative */
+static void addSigned(Blk *x, const Blk *y, bool neg, Index n) {
+    if (neg)
+        subBlocks(x, x, y, n);
+    else
+        addBlocks(x, x, y, n);
+}
+
+/* Writes the product of the pieces of a Toom-Cook split into r, which has 2n
+ * blocks. r[0, 2k) already holds c[0] = a0 b0, and r[(m - 1) 2k, 2n) holds
+ * the top coefficient; the middle coefficients c[1], ..., c[2m - 3] each have
+ * p blocks and go in at their offsets i k.
+ */
+static void recompose(Blk *r, Index n, Index k, unsigned int m,
+        Blk *const *c, Index p) {
+    zeroBlocks(r + 2 * k, (2 * m - 4) * k);
+    for (unsigned int i = 1; i <= 2 * m - 3; ++i)
+        addInto(r + i * k, 2 * n - i * k, c[i], p);
+}
+
+/* Toom-3: split each operand into three k-block pieces (the top one has s
+ * blocks), evaluate at 0, 1, -1, 2 and infinity, multiply pointwise and
+ * interpolate with Bodrato's sequence. Only the value at -1 can be negative,
+ * and every intermediate of the interpolation is a nonnegative combination of
+ * coefficients, so the signs never spread.
+ */
+void multiplyToom3(Blk *r, const Blk *a, const Blk *b, Index n) {
+    Index k = (n + 2) / 3, s = n - 2 * k, l = k + 1, p = 2 * l;
+    NumberlikeArray<Blk> scratch(7 * l + 3 * p + pieceScratchSize(k, s));
+    Blk *ea1 = scratch.blk, *eb1 = ea1 + l, *eam1 = eb1 + l, *ebm1 = eam1 + l;
+    Blk *ea2 = ebm1 + l, *eb2 = ea2 + l, *t = eb2 + l;
+    Blk *v1 = t + l, *vm1 = v1 + p, *v2 = vm1 + p, *ws = v2 + p;
+
+    // When squaring, evaluate once and let the pointwise products see equal
+    // operands, so they square too
+    const bool square = (a == b);
+    if (square) {
+        eb1 = ea1;
+        ebm1 = eam1;
+        eb2 = ea2;
+    }
+
+    // Evaluation. The operands are handled alike, so loop over them.
+    bool neg = false;
+    for (int side = 0; side < (square ? 1 : 2); ++side) {
+        const Blk *x = side ? b : a;
+        Blk *e1 = side ? eb1 : ea1, *em1 = side ? ebm1 : eam1;
+        Blk *e2 = side ? eb2 : ea2;
+        const Blk *x0 = x, *x1 = x + k, *x2 = x + 2 * k;
+        // t = x0 + x2; x(1) = t + x1; x(-1) = t - x1
+        copyBlocks(t, x0, k);
+        t[k] = 0;
+        addInto(t, l, x2, s);
+        copyBlocks(e1, t, l);
+        addInto(e1, l, x1, k);
+        copyBlocks(e2, x1, k);
+        e2[k] = 0;
+        neg ^= signedDifference(em1, t, e2, l);
+        // x(2) = x0 + 2 x1 + 4 x2
+        copyBlocks(e2, x0, k);
+        e2[k] = 0;
+        addMulInto(e2, l, x1, k, 2);
+        addMulInto(e2, l, x2, s, 4);
+    }
+    if (square)
+        neg = false;
+
+    // Pointwise products; c[0] and c[4] go straight into place
+    multiplyBalanced(r, a, b, k, ws);
+    multiplyBalanced(r + 4 * k, a + 2 * k, b + 2 * k, s, ws);
+    multiplyBalanced(v1, ea1, eb1, l, ws);
+    multiplyBalanced(vm1, eam1, ebm1, l, ws);
+    multiplyBalanced(v2, ea2, eb2, l, ws);
+    const Blk *v0 = r, *vinf = r + 4 * k;
+
+    // Interpolation
+    addSigned(v2, vm1, !neg, p);            // v2  = v(2) - v(-1)
+    divideExactly(v2, p, 3);                //     = c1 + c2 + 3 c3 + 5 c4
+    if (neg)                                // vm1 = v(1) - v(-1)
+        addBlocks(vm1, v1, vm1, p);
+    else
+        subBlocks(vm1, v1, vm1, p);
+    shiftRightBlocks(vm1, vm1, p, 1);       //     = c1 + c3
+    subInto(v1, p, v0, 2 * k);              // v1  = c1 + c2 + c3 + c4
+    subBlocks(v2, v2, v1, p);
+    shiftRightBlocks(v2, v2, p, 1);         // v2  = c3 + 2 c4
+    subBlocks(v1, v1, vm1, p);
+    subInto(v1, p, vinf, 2 * s);            // v1  = c2
+    subMulInto(v2, p, vinf, 2 * s, 2);      // v2  = c3
+    subBlocks(vm1, vm1, v2, p);             // vm1 = c1
+
+    Blk *c[4] = {NULL, vm1, v1, v2};
+    recompose(r, n, k, 3, c, p);
+}
+
+/* Toom-4: four pieces, evaluated at 0, 1, -1, 2, -2, 1/2 and infinity. The
+ * value at 1/2 is scaled by 8 to keep it integral. The even and odd parts of
+ * the product are recovered separately from the symmetric pairs of points,
+ * which again keeps every intermediate nonnegative.
+ */
+void multiplyToom4(Blk *r, const Blk *a, const Blk *b, Index n) {
+    Index k = (n + 3) / 4, s = n - 3 * k, l = k + 1, p = 2 * l;
+    NumberlikeArray<Blk> scratch(12 * l + 6 * p + pieceScratchSize(k, s));
+    Blk *ea1 = scratch.blk, *eb1 = ea1 + l, *eam1 = eb1 + l, *ebm1 = eam1 + l;
+    Blk *ea2 = ebm1 + l, *eb2 = ea2 + l, *eam2 = eb2 + l, *ebm2 = eam2 + l;
+    Blk *eah = ebm2 + l, *ebh = eah + l, *te = ebh + l, *to = te + l;
+    Blk *v1 = to + l, *vm1 = v1 + p, *v2 = vm1 + p, *vm2 = v2 + p;
+    Blk *vh = vm2 + p, *t = vh + p, *ws = t + p;
+
+    const bool square = (a == b);
+    if (square) {
+        eb1 = ea1;
+        ebm1 = eam1;
+        eb2 = ea2;
+        ebm2 = eam2;
+        ebh = eah;
+    }
+
+    bool neg1 = false, neg2 = false;
+    for (int side = 0; side < (square ? 1 : 2); ++side) {
+        const Blk *x = side ? b : a;
+        Blk *e1 = side ? eb1 : ea1, *em1 = side ? ebm1 : eam1;
+        Blk *e2 = side ? eb2 : ea2, *em2 = side ? ebm2 : eam2;
+        Blk *eh = side ? ebh : eah;
+        const Blk *x0 = x, *x1 = x + k, *x2 = x + 2 * k, *x3 = x + 3 * k;
+        // x(+-1) from te = x0 + x2 and to = x1 + x3
+        copyBlocks(te, x0, k);
+        te[k] = 0;
+        addInto(te, l, x2, k);
+        copyBlocks(to, x1, k);
+        to[k] = 0;
+        addInto(to, l, x3, s);
+        addBlocks(e1, te, to, l);
+        neg1 ^= signedDifference(em1, te, to, l);
+        // x(+-2) from te = x0 + 4 x2 and to = 2 x1 + 8 x3
+        copyBlocks(te, x0, k);
+        te[k] = 0;
+        addMulInto(te, l, x2, k, 4);
+        to[k] = mulBlocksByBlock(to, x1, k, 2);
+        addMulInto(to, l, x3, s, 8);
+        addBlocks(e2, te, to, l);
+        neg2 ^= signedDifference(em2, te, to, l);
+        // 8 x(1/2) = 8 x0 + 4 x1 + 2 x2 + x3
+        eh[k] = mulBlocksByBlock(eh, x0, k, 8);
+        addMulInto(eh, l, x1, k, 4);
+        addMulInto(eh, l, x2, k, 2);
+        addInto(eh, l, x3, s);
+    }
+    if (square)
+        neg1 = neg2 = false;
+
+    multiplyBalanced(r, a, b, k, ws);
+    multiplyBalanced(r + 6 * k, a + 3 * k, b + 3 * k, s, ws);
+    multiplyBalanced(v1, ea1, eb1, l, ws);
+    multiplyBalanced(vm1, eam1, ebm1, l, ws);
+    multiplyBalanced(v2, ea2, eb2, l, ws);
+    multiplyBalanced(vm2, eam2, ebm2, l, ws);
+    multiplyBalanced(vh, eah, ebh, l, ws);
+    const Blk *v0 = r, *vinf = r + 6 * k;
+
+    // Interpolation. First split the values at +-1 and +-2 into even and
+    // odd parts: vm1 = v(1) - v(-1) and v1 = v(1) + v(-1), and so on.
+    if (neg1)
+        addBlocks(vm1, v1, vm1, p);
+    else
+        subBlocks(vm1, v1, vm1, p);
+    addBlocks(v1, v1, v1, p);
+    subBlocks(v1, v1, vm1, p);
+    if (neg2)
+        addBlocks(vm2, v2, vm2, p);
+    else
+        subBlocks(vm2, v2, vm2, p);
+    addBlocks(v2, v2, v2, p);
+    subBlocks(v2, v2, vm2, p);
+    shiftRightBlocks(v1, v1, p, 1);         // v1  = c0 + c2 + c4 + c6
+    shiftRightBlocks(vm1, vm1, p, 1);       // vm1 = c1 + c3 + c5
+    shiftRightBlocks(v2, v2, p, 1);         // v2  = c0 + 4 c2 + 16 c4 + 64 c6
+    shiftRightBlocks(vm2, vm2, p, 2);       // vm2 = c1 + 4 c3 + 16 c5
+
+    // Even coefficients
+    subInto(v1, p, v0, 2 * k);
+    subInto(v1, p, vinf, 2 * s);            // v1  = c2 + c4
+    subInto(v2, p, v0, 2 * k);
+    subMulInto(v2, p, vinf, 2 * s, 64);
+    shiftRightBlocks(v2, v2, p, 2);         // v2  = c2 + 4 c4
+    subBlocks(v2, v2, v1, p);
+    divideExactly(v2, p, 3);                // v2  = c4
+    subBlocks(v1, v1, v2, p);               // v1  = c2
+
+    // Odd coefficients
+    subMulInto(vh, p, v0, 2 * k, 64);
+    subMulInto(vh, p, v1, p, 16);
+    subMulInto(vh, p, v2, p, 4);
+    subInto(vh, p, vinf, 2 * s);
+    shiftRightBlocks(vh, vh, p, 1);         // vh  = 16 c1 + 4 c3 + c5
+    subBlocks(vm2, vm2, vm1, p);
+    divideExactly(vm2, p, 3);               // vm2 = c3 + 5 c5
+    mulBlocksByBlock(t, vm1, p, 16);
+    subBlocks(vh, t, vh, p);
+    divideExactly(vh, p, 3);                // vh  = 4 c3 + 5 c5
+    subBlocks(vh, vh, vm2, p);
+    divideExactly(vh, p, 3);                // vh  = c3
+    subBlocks(vm2, vm2, vh, p);
+    divideExactly(vm2, p, 5);               // vm2 = c5
+    subBlocks(vm1, vm1, vh, p);
+    subBlocks(vm1, vm1, vm2, p);            // vm1 = c1
+
+    Blk *c[6] = {NULL, vm1, v1, vh, v2, vm2};
+    recompose(r, n, k, 4, c, p);
+}
+
+Index karatsubaSquareScratchSize(Index n) {
+    if (!useKaratsubaSquare(n))
+        return 0;
+    Index h2 = n - n / 2;
+    return 4 * h2 + karatsubaSquareScratchSize(h2);
+}
+
+Index squareScratchSize(Index n) {
+    if (useNtt(n))
+        return 0;
+    return balancedScratchSize(n);
+}
+
+void squareBlocks(Blk *r, const Blk *a, Index n, Blk *ws) {
+#ifdef BLOCKARITHMETIC_HAVE_NTT
+    if (useNtt(n)) {
+        multiplyNtt(r, a, n, a, n);
+        return;
+    }
+#endif
+    squareBalanced(r, a, n, ws);
+}
+
+Index multiplyScratchSize(Index an, Index bn) {
+    if (useNtt(bn) || !useSubquadratic(bn))
+        return 0;
+    Index s = balancedScratchSize(bn);
+    if (an == bn)
+        return s;
+    // Unbalanced products are done in bn-block slices of a
+    Index rem = an % bn;
+    if (rem != 0) {
+        Index s2 = multiplyScratchSize(bn, rem);
+        if (s2 > s)
+            s = s2;
+    }
+    return 2 * bn + s;
+}
+
+void multiplyBlocks(Blk *r, const Blk *a, Index an, const Blk *b, Index bn,
+        Blk *ws) {
+#ifdef BLOCKARITHMETIC_HAVE_NTT
+    // The transform takes unbalanced operands in its stride. It comes first,
+    // as in squareBlocks, so that its threshold stands on its own.
+    if (useNtt(bn)) {
+        multiplyNtt(r, a, an, b, bn);
+        return;
+    }
+#endif
+    if (!useSubquadratic(bn)) {
+        multiplySchoolbook(r, a, an, b, bn);
+        return;
+    }
+    if (an == bn) {
+        multiplyBalanced(r, a, b, bn, ws);
+        return;
+    }
+    // Multiply b by bn-block slices of a and accumulate the partial products
+    Blk *part = ws, *sub = ws + 2 * bn;
+    multiplyBalanced(r, a, b, bn, sub);
+    Index i;
+    for (i = bn; i + bn <= an; i += bn) {
+        multiplyBalanced(part, a + i, b, bn, sub);
+        // r[i, i + bn) already holds the top of the previous slice
+        // The sum is below B^(i + 2bn), so the final carry is zero
+        Blk carry = addBlocks(r + i, r + i, part, bn);
+        addBlock(r + i + bn, part + bn, bn, carry);
+    }
+    Index rem = an - i;
+    if (rem > 0) {
+        multiplyBlocks(part, b, bn, a + i, rem, sub);
+        Blk carry = addBlocks(r + i, r + i, part, bn);
+        addBlock(r + i + bn, part + bn, rem, carry);
+    }
+}
+
+}
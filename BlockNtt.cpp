@@ -0,0 +1,244 @@
+#include "BlockArithmetic.h"
+
+/* Multiplication by number-theoretic transform, for operands far beyond the
+ * Toom-Cook range. The blocks themselves are the convolution coefficients: a
+ * coefficient of the product is below L B^2 for a length-L transform, so the
+ * convolution is computed modulo three primes just under 2^62, whose product
+ * exceeds that bound for any L up to 2^56, and the three results are combined
+ * by the Chinese remainder theorem (Garner's formula).
+ *
+ * The primes have the form c 2^k + 1 with k >= 54, so transforms of up to 2^54
+ * points exist modulo all of them; memory runs out long before that.
+ */
+
+#ifdef BLOCKARITHMETIC_HAVE_NTT
+
+namespace BlockArithmetic {
+
+namespace {
+
+/* Arithmetic modulo one NTT prime p < 2^62. Products use Montgomery
+ * reduction with R = B; mul(x, y) returns x y / R mod p.
+ */
+class NttField {
+    public:
+        Blk p;      // The prime
+        Blk pInv;   // -1/p mod B
+        Blk r2;     // R^2 mod p
+        Blk g;      // A primitive root mod p
+
+        NttField(Blk prime, Blk root) : p(prime), g(root) {
+            pInv = p;
+            for (unsigned int bits = 3; bits < N; bits *= 2)
+                pInv *= 2 - p * pInv;
+            pInv = 0 - pInv;
+            // R mod p, then doubled N times to get R^2 mod p
+            r2 = (0 - p) % p;
+            for (unsigned int i = 0; i < N; ++i)
+                r2 = add(r2, r2);
+        }
+
+        Blk add(Blk x, Blk y) const {
+            Blk s = x + y;
+            return (s >= p) ? s - p : s;
+        }
+        Blk sub(Blk x, Blk y) const {
+            return (x >= y) ? x - y : x + p - y;
+        }
+        Blk mul(Blk x, Blk y) const {
+            Blk hi, lo = mulBlock(x, y, hi);
+            Blk mh, m = lo * pInv;
+            mulBlock(m, p, mh);
+            // lo + m p is divisible by B; its low half carries iff lo != 0
+            Blk t = hi + mh + (lo != 0);
+            return (t >= p) ? t - p : t;
+        }
+        // Converts into Montgomery form
+        Blk toMont(Blk x) const { return mul(x, r2); }
+        // x^e for x in Montgomery form, result in Montgomery form
+        Blk pow(Blk x, Blk e) const {
+            Blk r = toMont(1);
+            for (; e != 0; e >>= 1) {
+                if (e & 1)
+                    r = mul(r, x);
+                x = mul(x, x);
+            }
+            return r;
+        }
+};
+
+const NttField fields[3] = {
+    NttField(0x3a00000000000001UL, 3),   // 29 * 2^57 + 1
+    NttField(0x2c40000000000001UL, 7),   // 177 * 2^54 + 1
+    NttField(0x2280000000000001UL, 5)    // 69 * 2^55 + 1
+};
+
+typedef unsigned long Size;
+
+/* Fills w[h + j] with the Montgomery form of w_2h^j for every power of two h
+ * below len and j < h, where w_2h is a primitive 2h-th root of unity.
+ */
+void buildRoots(const NttField &f, Blk *w, Size len) {
+    Size half = len / 2;
+    Blk root = f.pow(f.toMont(f.g), (f.p - 1) / len);
+    Blk x = f.toMont(1);
+    for (Size j = 0; j < half; ++j) {
+        w[half + j] = x;
+        x = f.mul(x, root);
+    }
+    for (Size h = half / 2; h >= 1; h /= 2)
+        for (Size j = 0; j < h; ++j)
+            w[h + j] = w[2 * h + 2 * j];
+}
+
+/* Decimation-in-frequency transform: natural order in, bit-reversed out.
+ * The twiddles are in Montgomery form, so the data stays in plain form.
+ */
+void forward(const NttField &f, Blk *x, Size len, const Blk *w) {
+    for (Size h = len / 2; h >= 1; h /= 2)
+        for (Size i = 0; i < len; i += 2 * h)
+            for (Size j = 0; j < h; ++j) {
+                Blk u = x[i + j], v = x[i + j + h];
+                x[i + j] = f.add(u, v);
+                x[i + j + h] = f.mul(f.sub(u, v), w[h + j]);
+            }
+}
+
+/* Decimation-in-time inverse, bit-reversed in, natural order out, without
+ * the final division by len. Since w_2h^h = -1, the inverse twiddle
+ * w_2h^-j is -w_2h^(h - j), so the forward table serves both directions.
+ */
+void inverse(const NttField &f, Blk *x, Size len, const Blk *w) {
+    for (Size h = 1; h < len; h *= 2)
+        for (Size i = 0; i < len; i += 2 * h) {
+            Blk u = x[i], v = x[i + h];
+            x[i] = f.add(u, v);
+            x[i + h] = f.sub(u, v);
+            for (Size j = 1; j < h; ++j) {
+                u = x[i + j];
+                v = f.mul(x[i + j + h], w[2 * h - j]);
+                x[i + j] = f.sub(u, v);
+                x[i + j + h] = f.add(u, v);
+            }
+        }
+}
+
+/* Reduces the n blocks of a modulo p into x, zero-padded to len */
+void load(const NttField &f, Blk *x, Size len, const Blk *a, Index n) {
+    for (Size i = 0; i < n; ++i)
+        x[i] = a[i] % f.p;
+    for (Size i = n; i < len; ++i)
+        x[i] = 0;
+}
+
+/* Leaves the cyclic convolution of a and b modulo f.p in x; y is scratch */
+void convolve(const NttField &f, Blk *x, Blk *y, Blk *w, Size len,
+        const Blk *a, Index an, const Blk *b, Index bn) {
+    buildRoots(f, w, len);
+    load(f, x, len, a, an);
+    forward(f, x, len, w);
+    // A square needs just the one transform
+    if (a != b || an != bn) {
+        load(f, y, len, b, bn);
+        forward(f, y, len, w);
+    } else
+        y = x;
+    // mul(mul(x, y), c) = x y / len, with c = R^2 / len in plain form
+    Blk c = f.mul(f.r2, f.pow(f.toMont(len), f.p - 2));
+    for (Size i = 0; i < len; ++i)
+        x[i] = f.mul(f.mul(x[i], y[i]), c);
+    inverse(f, x, len, w);
+}
+
+/* Computes the convolution of a and b with a transform of length len and
+ * recombines it into rn blocks of r. When cyclic, rn is len and the
+ * coefficients' carries out of the top wrap around to the bottom.
+ */
+void transformMultiply(Blk *r, Size rn, const Blk *a, Index an,
+        const Blk *b, Index bn, Size len, bool cyclic) {
+    // Residues modulo each prime, plus space for the second operand and the
+    // root table. The third residue stays in the first operand's space.
+    // Its length is an Index, so longer operands cannot be transformed.
+    if (len > Size(Index(~Index(0))) / 5)
+        throw "transformMultiply: operands are too long";
+    NumberlikeArray<Blk> scratch(Index(5 * len));
+    Blk *x1 = scratch.blk, *x2 = x1 + len, *x3 = x2 + len;
+    Blk *y = x3 + len, *w = y + len;
+    convolve(fields[0], x1, y, w, len, a, an, b, bn);
+    convolve(fields[1], x2, y, w, len, a, an, b, bn);
+    convolve(fields[2], x3, y, w, len, a, an, b, bn);
+
+    // Garner's constants, all in Montgomery form: 1/p1 mod p2,
+    // 1/(p1 p2) mod p3, and p1 and p2 mod p3
+    const NttField &f1 = fields[0], &f2 = fields[1], &f3 = fields[2];
+    const Blk p1 = f1.p, p2 = f2.p;
+    Blk inv12 = f2.pow(f2.toMont(p1 % p2), p2 - 2);
+    Blk p1m3 = f3.toMont(p1 % f3.p), p2m3 = f3.toMont(p2 % f3.p);
+    Blk inv123 = f3.pow(f3.mul(p1m3, p2m3), f3.p - 2);
+    // p1 p2 as a double block
+    Blk p12[2];
+    p12[0] = mulBlock(p1, p2, p12[1]);
+
+    // Recombine coefficient i into x = r1 + p1 t1 + p1 p2 t2 < p1 p2 p3 and
+    // add it into the product at block i. The running sum acc stays below
+    // B^3, so no carry ever leaves it.
+    Blk acc[3] = {0, 0, 0}, x[3];
+    for (Size i = 0; i < rn; ++i) {
+        Blk r1 = 0, r2 = 0, r3 = 0;
+        if (i < len) {
+            r1 = x1[i];
+            r2 = x2[i];
+            r3 = x3[i];
+        }
+        // r1 < p1 < 2 p2 and t1 < p2 < 2 p3 need at most one reduction
+        Blk r1m2 = (r1 >= p2) ? r1 - p2 : r1;
+        Blk t1 = f2.mul(f2.sub(r2, r1m2), inv12);
+        Blk r1m3 = (r1 >= f3.p) ? r1 - f3.p : r1;
+        Blk t1m3 = (t1 >= f3.p) ? t1 - f3.p : t1;
+        Blk u = f3.add(r1m3, f3.mul(p1m3, t1m3));
+        Blk t2 = f3.mul(f3.sub(r3, u), inv123);
+
+        x[2] = mulBlocksByBlock(x, p12, 2, t2);
+        Blk carry = addMulBlock(x, &p1, 1, t1);
+        addBlock(x + 1, x + 1, 2, carry);
+        addBlock(x, x, 3, r1);
+
+        addBlocks(acc, acc, x, 3);
+        r[i] = acc[0];
+        acc[0] = acc[1];
+        acc[1] = acc[2];
+        acc[2] = 0;
+    }
+    if (cyclic) {
+        // acc is worth acc B^len = acc modulo B^len - 1
+        Blk carry = addBlocks(r, r, acc, 2);
+        carry = addBlock(r + 2, r + 2, Index(len - 2), carry);
+        addBlock(r, r, Index(len), carry);
+    }
+}
+
+}
+
+void multiplyNtt(Blk *r, const Blk *a, Index an, const Blk *b, Index bn) {
+    Size rn = Size(an) + bn, len = 1;
+    while (len < rn - 1)
+        len *= 2;
+    if (len < 2)
+        len = 2;
+    transformMultiply(r, rn, a, an, b, bn, len, false);
+}
+
+Index nttCyclicLength(Index n) {
+    Index len = 2;
+    while (len < n)
+        len *= 2;
+    return len;
+}
+
+void multiplyNttCyclic(Blk *r, const Blk *a, Index an, const Blk *b, Index bn,
+        Index len) {
+    transformMultiply(r, len, a, an, b, bn, len, true);
+}
+}
+
+#endif
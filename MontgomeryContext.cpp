@@ -0,0 +1,396 @@
+#include "MontgomeryContext.h"
+#include "BlockArithmetic.h"
+
+using namespace BlockArithmetic;
+
+void MontgomeryContext::padBlocks(Blk *r, const BigUnsigned &x, Index k) {
+    copyBlocks(r, x.blk, x.len);
+    zeroBlocks(r + x.len, k - x.len);
+}
+
+void MontgomeryContext::chunk(Blk *r, const BigUnsigned &x, Index j) const {
+    Index from = j * k, l = 0;
+    if (from < x.len)
+        l = (x.len - from < k) ? x.len - from : k;
+    copyBlocks(r, x.blk + from, l);
+    zeroBlocks(r + l, k - l);
+}
+
+MontgomeryContext::MontgomeryContext(const BigUnsigned &modulus)
+        : n(modulus), k(modulus.len), r2(k), one(k) {
+    if (n.isZero() || (n.blk[0] & 1) == 0)
+        throw "MontgomeryContext::MontgomeryContext: modulus must be odd";
+    // Newton's iteration for 1/n mod B doubles the correct low bits each
+    // time, starting from 3 (n n = 1 mod 8 for odd n)
+    Blk n0 = n.blk[0], inv = n0;
+    for (unsigned int bits = 3; bits < N; bits *= 2)
+        inv *= 2 - n0 * inv;
+    nInv = 0 - inv;
+
+    // R mod n and R^2 mod n, by division once and for all
+    NumberlikeArray<Blk> power(2 * k + 1);
+    zeroBlocks(power.blk, 2 * k);
+    power.blk[2 * k] = 1;
+    BigUnsigned q, rem(power.blk, 2 * k + 1);
+    rem.divideWithRemainder(n, q);
+    padBlocks(r2.blk, rem, k);
+    rem = BigUnsigned(power.blk + k, k + 1);
+    rem.divideWithRemainder(n, q);
+    padBlocks(one.blk, rem, k);
+    // Mark the blocks as used, so that copies of the context copy them
+    r2.len = one.len = k;
+}
+
+MontgomeryContext::Index MontgomeryContext::getScratchSize() const {
+    return 2 * k + 1 + squareScratchSize(k);
+}
+
+/* CIOS with the two inner loops fused: for each block a[i], one pass over j
+ * adds a[i] b[j] and m n[j] into the running total t and shifts it down a
+ * block, m being chosen so that the block shifted out is zero. t < 2n
+ * throughout, so it fits in r plus one top bit, and a final subtraction
+ * brings it below n.
+ */
+void MontgomeryContext::montMul(Blk *r, const Blk *a, const Blk *b) const {
+    const Blk *np = n.blk;
+    zeroBlocks(r, k);
+    Blk top = 0;
+    for (Index i = 0; i < k; ++i) {
+        Blk ai = a[i], hi1, hi2;
+        // j = 0 decides m
+        Blk lo = mulBlock(ai, b[0], hi1);
+        Blk s = r[0] + lo;
+        Blk c1 = hi1 + (s < lo);
+        Blk m = s * nInv;
+        lo = mulBlock(m, np[0], hi2);
+        s += lo;
+        Blk c2 = hi2 + (s < lo);
+        for (Index j = 1; j < k; ++j) {
+            lo = mulBlock(ai, b[j], hi1);
+            s = r[j] + lo;
+            Blk c = (s < lo);
+            s += c1;
+            c1 = hi1 + c + (s < c1);
+            lo = mulBlock(m, np[j], hi2);
+            s += lo;
+            c = (s < lo);
+            s += c2;
+            c2 = hi2 + c + (s < c2);
+            r[j - 1] = s;
+        }
+        s = top + c1;
+        Blk c = (s < c1);
+        s += c2;
+        c += (s < c2);
+        r[k - 1] = s;
+        top = c;
+    }
+    subtractIfAbove(r, top);
+}
+
+/* Subtracts n from top B^k + r when that is at least n, without branching on
+ * the outcome of the comparison: a dry run of the subtraction finds the
+ * borrow, then n masked to all ones or all zeros is subtracted.
+ */
+void MontgomeryContext::subtractIfAbove(Blk *r, Blk top) const {
+    const Blk *np = n.blk;
+    Blk borrow = 0;
+    for (Index i = 0; i < k; ++i) {
+        Blk d = r[i] - np[i];
+        borrow = (r[i] < np[i]) | (d < borrow);
+    }
+    Blk mask = 0 - (top | (borrow ^ 1));
+    borrow = 0;
+    for (Index i = 0; i < k; ++i) {
+        Blk x = r[i], y = np[i] & mask, d = x - y;
+        Blk bo = (x < y);
+        r[i] = d - borrow;
+        borrow = bo | (d < borrow);
+    }
+}
+
+/* Montgomery reduction of the 2k blocks at t into r, one block at a time:
+ * m = t[i] (-1/n) clears block i of t + m n B^i.
+ */
+void MontgomeryContext::reduce(Blk *r, Blk *t) const {
+    const Blk *np = n.blk;
+    Blk top = 0;
+    for (Index i = 0; i < k; ++i) {
+        Blk m = t[i] * nInv;
+        Blk c = addMulBlock(t + i, np, k, m);
+        Blk s = t[i + k] + c;
+        Blk cc = (s < c);
+        s += top;
+        top = cc + (s < top);
+        t[i + k] = s;
+    }
+    subtractIfAbove(t + k, top);
+    copyBlocks(r, t + k, k);
+}
+
+/* The square first, with each cross product computed once, then the
+ * reduction
+ */
+void MontgomeryContext::montSqr(Blk *r, const Blk *a, Blk *ws) const {
+    if (k < BigUnsigned::karatsubaSquareThreshold)
+        squareSchoolbook(ws, a, k);
+    else
+        squareBlocks(ws, a, k, ws + 2 * k + 1);
+    reduce(r, ws);
+}
+
+void MontgomeryContext::addMod(Blk *r, const Blk *a, const Blk *b) const {
+    subtractIfAbove(r, addBlocks(r, a, b, k));
+}
+
+/* n is added back when the subtraction borrows, masked to all ones or all
+ * zeros rather than branched on, as in subtractIfAbove
+ */
+void MontgomeryContext::subMod(Blk *r, const Blk *a, const Blk *b) const {
+    Blk mask = 0 - subBlocks(r, a, b, k);
+    Blk carry = 0;
+    for (Index i = 0; i < k; ++i) {
+        Blk y = n.blk[i] & mask, s = r[i] + carry;
+        carry = (s < carry);
+        s += y;
+        carry += (s < y);
+        r[i] = s;
+    }
+}
+
+void MontgomeryContext::halveMod(Blk *r, const Blk *a) const {
+    Blk top = 0;
+    if ((a[0] & 1) != 0)
+        top = addBlocks(r, a, n.blk, k);
+    else if (r != a)
+        copyBlocks(r, a, k);
+    shiftRightBlocks(r, r, k, 1);
+    r[k - 1] |= top << (N - 1);
+}
+
+/* x is split into k-block chunks x_j < R, each of which montMul takes as is
+ * against R^2 mod n < n to give x_j R mod n. Then x R is built from the top
+ * chunk down as acc R + x_j R, without dividing, so the time depends only
+ * on the length of x.
+ */
+void MontgomeryContext::toMontgomery(Blk *r, const BigUnsigned &x) const {
+    NumberlikeArray<Blk> xj(k), t(k);
+    Index j = (x.len == 0) ? 0 : (x.len - 1) / k;
+    chunk(xj.blk, x, j);
+    montMul(r, xj.blk, r2.blk);
+    for (; j > 0; --j) {
+        montMul(t.blk, r, r2.blk);
+        chunk(xj.blk, x, j - 1);
+        montMul(r, xj.blk, r2.blk);
+        addMod(r, r, t.blk);
+    }
+}
+
+void MontgomeryContext::fromMontgomery(BigUnsigned &r, const Blk *x) const {
+    // Multiplying by plain 1 divides by R
+    NumberlikeArray<Blk> plainOne(k), t(k);
+    zeroBlocks(plainOne.blk, k);
+    plainOne.blk[0] = 1;
+    montMul(t.blk, x, plainOne.blk);
+    r = BigUnsigned(t.blk, k);
+}
+
+BigUnsigned MontgomeryContext::toMontgomery(const BigUnsigned &x) const {
+    NumberlikeArray<Blk> t(k);
+    toMontgomery(t.blk, x);
+    return BigUnsigned(t.blk, k);
+}
+
+BigUnsigned MontgomeryContext::fromMontgomery(const BigUnsigned &x) const {
+    NumberlikeArray<Blk> t(k);
+    padBlocks(t.blk, x, k);
+    BigUnsigned r;
+    fromMontgomery(r, t.blk);
+    return r;
+}
+
+namespace {
+
+/* Bit i of the exponent's blocks */
+inline unsigned int expBit(const Blk *e, Index i) {
+    return (e[i / N] >> (i % N)) & 1;
+}
+
+}
+
+/* Window widths for exponents of a given length that minimize the squarings
+ * plus multiplications, table included (as in OpenSSL)
+ */
+unsigned int MontgomeryContext::windowBits(Index bits) {
+    return (bits > 671) ? 6 : (bits > 239) ? 5 : (bits > 79) ? 4
+        : (bits > 23) ? 3 : (bits > 1) ? 2 : 1;
+}
+
+BigUnsigned MontgomeryContext::modPow(const BigUnsigned &base,
+        const BigUnsigned &exp) const {
+    if (exp.isZero())
+        return fromMontgomery(BigUnsigned(one.blk, k));
+    Index bits = (exp.len - 1) * N + (N - countLeadingZeros(exp.blk[exp.len - 1]));
+    unsigned int w = windowBits(bits);
+    Index powers = Index(1) << (w - 1);
+    // A one-block exponent with so few set bits that building the table
+    // would cost more multiplications than it saves, like 65537
+    if (exp.len == 1 && countOnes(exp.blk[0]) <= powers + 1)
+        return modPowSmall(base, exp.blk[0]);
+
+    // The table of odd powers g^1, g^3, ..., g^(2 powers - 1), then the
+    // accumulator and its spare, then montSqr's scratch
+    NumberlikeArray<Blk> space((powers + 2) * k + getScratchSize());
+    Blk *table = space.blk, *acc = table + powers * k, *spare = acc + k;
+    Blk *ws = spare + k;
+    toMontgomery(table, base);
+    if (powers > 1) {
+        montSqr(spare, table, ws);
+        for (Index i = 1; i < powers; ++i)
+            montMul(table + i * k, table + (i - 1) * k, spare);
+    }
+
+    // Left to right: a window runs from a set bit down over at most w bits
+    // and ends on a set bit, so its value is odd. The first window loads
+    // the accumulator instead of multiplying into 1.
+    bool started = false;
+    Index i = bits;
+    while (i > 0) {
+        if (!expBit(exp.blk, i - 1)) {
+            montSqr(acc, acc, ws);
+            --i;
+            continue;
+        }
+        Index j = (i > w) ? i - w : 0;
+        while (!expBit(exp.blk, j))
+            ++j;
+        Index value = 0;
+        for (Index b = i; b > j; --b)
+            value = 2 * value + expBit(exp.blk, b - 1);
+        const Blk *g = table + (value / 2) * k;
+        if (started) {
+            for (Index b = i; b > j; --b)
+                montSqr(acc, acc, ws);
+            montMul(spare, acc, g);
+            Blk *t = acc;
+            acc = spare;
+            spare = t;
+        } else {
+            copyBlocks(acc, g, k);
+            started = true;
+        }
+        i = j;
+    }
+    BigUnsigned r;
+    fromMontgomery(r, acc);
+    return r;
+}
+
+/* Left-to-right binary exponentiation: a squaring per bit and a
+ * multiplication per set bit after the first, and no table. When e is odd,
+ * as public exponents are, the last multiplication is by the plain base,
+ * which cancels the R of the accumulator and saves converting back.
+ */
+BigUnsigned MontgomeryContext::modPowSmall(const BigUnsigned &base,
+        Blk e) const {
+    NumberlikeArray<Blk> space(4 * k + getScratchSize());
+    Blk *plain = space.blk, *g = plain + k, *acc = g + k, *spare = acc + k;
+    Blk *ws = spare + k;
+    if (base.len > k || (base.len == k && base >= n))
+        padBlocks(plain, base % n, k);
+    else
+        padBlocks(plain, base, k);
+    montMul(g, plain, r2.blk);
+    copyBlocks(acc, g, k);
+    for (unsigned int b = N - 1 - countLeadingZeros(e); b > 1; --b) {
+        montSqr(acc, acc, ws);
+        if ((e >> (b - 1)) & 1) {
+            montMul(spare, acc, g);
+            Blk *t = acc;
+            acc = spare;
+            spare = t;
+        }
+    }
+    BigUnsigned r;
+    if (e == 1)
+        r = BigUnsigned(plain, k);
+    else {
+        montSqr(acc, acc, ws);
+        if (e & 1) {
+            montMul(spare, acc, plain);
+            r = BigUnsigned(spare, k);
+        } else
+            fromMontgomery(r, acc);
+    }
+    return r;
+}
+
+namespace {
+
+/* All ones if x == y, else zero, without a branch */
+inline Blk equalMask(Blk x, Blk y) {
+    Blk d = x ^ y;
+    return ((d | (0 - d)) >> (N - 1)) - 1;
+}
+
+/* Window i of width w of the exponent's blocks, bits [i w, (i + 1) w) */
+inline Index expWindow(const Blk *e, Index en, Index i, unsigned int w) {
+    Index value = 0;
+    for (unsigned int b = w; b > 0; --b) {
+        Index bit = i * w + b - 1;
+        value = 2 * value + ((bit < en * N) ? expBit(e, bit) : 0);
+    }
+    return value;
+}
+
+}
+
+BigUnsigned MontgomeryContext::modPowConstantTime(const BigUnsigned &base,
+        const BigUnsigned &exp) const {
+    Index bits = exp.len * N;
+    if (bits == 0)
+        return fromMontgomery(BigUnsigned(one.blk, k));
+    unsigned int w = windowBits(bits);
+    Index size = Index(1) << w, windows = (bits + w - 1) / w;
+
+    // The table holds g^0, ..., g^(size - 1) with block j of g^i at
+    // table[j size + i]. Then the accumulator, a power being looked up and
+    // the squaring's double-length result.
+    NumberlikeArray<Blk> space(size * k + 4 * k);
+    Blk *table = space.blk, *acc = table + size * k, *g = acc + k;
+    Blk *t = g + k;
+    toMontgomery(g, base);
+    copyBlocks(acc, one.blk, k);
+    for (Index i = 0; i < size; ++i) {
+        for (Index j = 0; j < k; ++j)
+            table[j * size + i] = acc[j];
+        montMul(t, acc, g);
+        copyBlocks(acc, t, k);
+    }
+
+    // Left to right, one window at a time. The lookup of g^value reads
+    // every entry and keeps the one whose mask is all ones.
+    for (Index i = windows; i > 0; --i) {
+        Index value = expWindow(exp.blk, exp.len, i - 1, w);
+        for (Index j = 0; j < k; ++j) {
+            const Blk *column = table + j * size;
+            Blk x = 0;
+            for (Index e = 0; e < size; ++e)
+                x |= column[e] & equalMask(e, value);
+            g[j] = x;
+        }
+        if (i == windows) {
+            copyBlocks(acc, g, k);
+            continue;
+        }
+        for (unsigned int b = 0; b < w; ++b) {
+            squareSchoolbook(t, acc, k);
+            reduce(acc, t);
+        }
+        montMul(t, acc, g);
+        copyBlocks(acc, t, k);
+    }
+    BigUnsigned r;
+    fromMontgomery(r, acc);
+    return r;
+}
@@ -0,0 +1,126 @@
+#ifndef MONTGOMERYCONTEXT_H
+#define MONTGOMERYCONTEXT_H
+
+#include "BigUnsigned.h"
+
+/* A MontgomeryContext does arithmetic modulo one fixed odd modulus n of k
+ * blocks without dividing. Values are kept in Montgomery form x R mod n,
+ * where R = B^k and B is the block base, in which the product of two values
+ * is a R b R R^-1 = (a b) R: montMul multiplies and divides by R in a single
+ * pass over the blocks (Koc, Acar and Kaliski's CIOS method), which needs only
+ * the precomputed -1/n mod B.
+ *
+ * montMul and montSqr work on raw arrays of exactly k blocks holding values
+ * below n and do not modify the context, so one context may be shared by any
+ * number of threads. Their final subtraction of n is branch-free. montMul,
+ * and montSqr below karatsubaSquareThreshold, where it squares by
+ * schoolbook, therefore take the same time for all inputs of a given
+ * length; above it, montSqr's Karatsuba, Toom-Cook and transform squaring
+ * branch on the data, so modPowConstantTime squares by schoolbook instead.
+ * Neither allocates, except that montSqr squares with Toom-Cook or the
+ * transform, which bring their own scratch, when k is that large. The
+ * conversions in and out of Montgomery form go through BigUnsigned and may
+ * allocate; they are meant to be done once per exponentiation, not per
+ * multiplication.
+ */
+class MontgomeryContext {
+
+    public:
+        typedef BigUnsigned::Blk   Blk;
+        typedef BigUnsigned::Index Index;
+
+        /* Throws an exception if n is even (or zero) */
+        MontgomeryContext(const BigUnsigned &n);
+
+        const BigUnsigned &getModulus() const { return n; }
+        // The number of blocks k in every Montgomery-form array
+        Index getLength() const { return k; }
+        // The number of scratch blocks montSqr needs
+        Index getScratchSize() const;
+        // R mod n, the Montgomery form of 1, as k blocks
+        const Blk *getOne() const { return one.blk; }
+
+        // CONVERSIONS
+
+        /* r[0, k) = x R mod n. x may be any size; it is reduced without
+         * dividing, in a time that depends only on its length.
+         */
+        void toMontgomery(Blk *r, const BigUnsigned &x) const;
+        /* r = x R^-1 mod n, for the k blocks at x */
+        void fromMontgomery(BigUnsigned &r, const Blk *x) const;
+
+        // Return-by-value versions, with Montgomery forms as BigUnsigneds
+        BigUnsigned toMontgomery(const BigUnsigned &x) const;
+        BigUnsigned fromMontgomery(const BigUnsigned &x) const;
+
+        // MONTGOMERY ARITHMETIC
+
+        /* r = a b R^-1 mod n. r must not overlap a or b. */
+        void montMul(Blk *r, const Blk *a, const Blk *b) const;
+        /* r = a^2 R^-1 mod n, using getScratchSize() blocks at ws. r may be
+         * a, but neither may overlap ws.
+         */
+        void montSqr(Blk *r, const Blk *a, Blk *ws) const;
+
+        // MODULAR ADDITION
+        // These work on k-block values below n, whether in Montgomery form
+        // or not, since the form is linear. r may be either input. addMod
+        // and subMod do not branch on the values.
+
+        /* r = a + b mod n */
+        void addMod(Blk *r, const Blk *a, const Blk *b) const;
+        /* r = a - b mod n */
+        void subMod(Blk *r, const Blk *a, const Blk *b) const;
+        /* r = a / 2 mod n, that is, (a + n) / 2 for odd a */
+        void halveMod(Blk *r, const Blk *a) const;
+
+        // EXPONENTIATION
+
+        /* base^exp mod n, by a sliding window over the bits of exp whose
+         * width grows with the length of exp. The odd powers of base the
+         * window needs and all other scratch share a single allocation.
+         * Small one-block exponents such as 65537 skip the table and take
+         * plain square and multiply. Its time depends on exp; it is not for
+         * secret exponents.
+         */
+        BigUnsigned modPow(const BigUnsigned &base, const BigUnsigned &exp) const;
+
+        /* base^exp mod n for a secret exp: a fixed window, so the sequence
+         * of squarings and multiplications depends only on the number of
+         * blocks in exp, and a table lookup that reads every entry. The
+         * table is stored interleaved, block j of every power side by side,
+         * so a lookup touches the same cache lines whatever the index.
+         * Squaring uses the schoolbook method, whose Karatsuba alternative
+         * branches on the data.
+         */
+        BigUnsigned modPowConstantTime(const BigUnsigned &base,
+                const BigUnsigned &exp) const;
+
+    private:
+        BigUnsigned n;
+        Index k;
+        // -1/n mod B
+        Blk nInv;
+        // R^2 mod n and R mod n, as k blocks each
+        NumberlikeArray<Blk> r2;
+        NumberlikeArray<Blk> one;
+
+        /* Copies x, of at most k blocks, into r and zero-pads it to k */
+        static void padBlocks(Blk *r, const BigUnsigned &x, Index k);
+        /* Copies blocks [j k, j k + k) of x into r, zero-padded past its
+         * end
+         */
+        void chunk(Blk *r, const BigUnsigned &x, Index j) const;
+        /* The sliding window width for an exponent of the given length */
+        static unsigned int windowBits(Index bits);
+        /* modPow for a one-block exponent e > 0, without the table */
+        BigUnsigned modPowSmall(const BigUnsigned &base, Blk e) const;
+        /* Subtracts n from top B^k + r if it is at least n, in time that
+         * does not depend on whether it is
+         */
+        void subtractIfAbove(Blk *r, Blk top) const;
+        /* r = t R^-1 mod n for the 2k blocks at t < n R, which it destroys */
+        void reduce(Blk *r, Blk *t) const;
+};
+
+#endif
@@ -0,0 +1,429 @@
+#include "RsaKeyPool.h"
+#include "BigUnsignedAlgorithms.h"
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+typedef RsaKeyPool::Blk   Blk;
+typedef RsaKeyPool::Index Index;
+
+std::string toHex(const BigUnsigned &x) {
+    static const char digits[] = "0123456789abcdef";
+    Index n = (x.bitLength() + 3) / 4;
+    if (n == 0)
+        return "0";
+    std::string s(n, '0');
+    for (Index i = 0; i < n; ++i) {
+        unsigned int d = 0;
+        for (unsigned int b = 0; b < 4; ++b)
+            d |= (unsigned int)x.getBit(4 * i + b) << b;
+        s[n - 1 - i] = digits[d];
+    }
+    return s;
+}
+
+BigUnsigned fromHex(const std::string &s) {
+    if (s.empty())
+        throw "RsaKeyPool: malformed number in the pool file";
+    BigUnsigned x;
+    for (unsigned int i = 0; i < s.size(); ++i) {
+        char c = s[i];
+        Blk d;
+        if (c >= '0' && c <= '9')
+            d = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            d = c - 'a' + 10;
+        else
+            throw "RsaKeyPool: malformed number in the pool file";
+        x <<= 4;
+        x += BigUnsigned(d);
+    }
+    return x;
+}
+
+/* The components of a key after its id on its line: p, q, dP, dQ and qInv,
+ * then each further prime with its exponent and coefficient
+ */
+std::string keyFields(const RsaPrivateKey &key) {
+    std::ostringstream out;
+    out << toHex(key.getP()) << ' ' << toHex(key.getQ()) << ' '
+        << toHex(key.getDP()) << ' ' << toHex(key.getDQ()) << ' '
+        << toHex(key.getQInv());
+    std::vector<RsaPrivateKey::OtherPrime> others = key.getOtherPrimes();
+    for (unsigned int i = 0; i < others.size(); ++i)
+        out << ' ' << toHex(others[i].prime) << ' '
+            << toHex(others[i].exponent) << ' '
+            << toHex(others[i].coefficient);
+    return out.str();
+}
+
+/* A random safe prime of exactly the given number of bits: the next one up
+ * from a random number of that length, unless that runs past the top. Zero
+ * if *stop turns true first.
+ */
+BigUnsigned randomSafePrime(std::random_device &source, Index bits,
+        const std::atomic<bool> *stop) {
+    for (;;) {
+        // 32 random bits at a time, the excess shifted off, the top one set
+        BigUnsigned start;
+        Index words = (bits + 31) / 32;
+        for (Index i = 0; i < words; ++i) {
+            start <<= 32;
+            start += BigUnsigned(Blk(source() & 0xffffffffu));
+        }
+        start >>= 32 * words - bits;
+        if (!start.getBit(bits - 1))
+            start += BigUnsigned(1) << (bits - 1);
+        BigUnsigned p = nextSafePrime(start, stop);
+        if (p.isZero() || p.bitLength() == bits)
+            return p;
+    }
+}
+
+/* Moves the calling thread to the idle scheduling class, where it only gets
+ * time no other thread wants; elsewhere than Linux the threads run at the
+ * normal priority
+ */
+void lowerPriority() {
+#if defined(__linux__) && defined(SCHED_IDLE)
+    sched_param param;
+    param.sched_priority = 0;
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+}
+
+/* Writes all of s to fd, through short writes and interruptions */
+bool writeAll(int fd, const std::string &s) {
+    const char *p = s.data();
+    std::string::size_type left = s.size();
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        left -= n;
+    }
+    return true;
+}
+
+/* Flushes the directory holding path, so that a rename into it lasts */
+bool syncDirectory(const std::string &path) {
+    std::string::size_type slash = path.rfind('/');
+    std::string directory = (slash == std::string::npos) ? "."
+        : (slash == 0) ? "/" : path.substr(0, slash);
+    int fd = open(directory.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    bool synced = fsync(fd) == 0;
+    return (close(fd) == 0) && synced;
+}
+
+}
+
+RsaKeyPool::RsaKeyPool(Index bits, unsigned int lowWatermark,
+        unsigned int highWatermark, const std::string &path,
+        unsigned int threads, Index safePrimeBits, unsigned int primeCount,
+        Blk e)
+        : bits(bits), safePrimeBits(safePrimeBits), lowWatermark(lowWatermark),
+        highWatermark(highWatermark), primeCount(primeCount), e(e), path(path),
+        keysInProgress(0), safePrimesInProgress(0), nextId(0), stopping(false) {
+    if (highWatermark == 0 || lowWatermark > highWatermark)
+        throw "RsaKeyPool::RsaKeyPool: watermarks out of order";
+    if (primeCount < 2 || bits / primeCount < 32)
+        throw "RsaKeyPool::RsaKeyPool: too few bits for that many primes";
+    if (e <= 1 || e % 2 == 0)
+        throw "RsaKeyPool::RsaKeyPool: public exponent must be odd and above 1";
+    if (safePrimeBits == 1 || safePrimeBits == 2)
+        throw "RsaKeyPool::RsaKeyPool: no safe prime has so few bits";
+    if (!path.empty()) {
+        load();
+        if (!save())
+            throw "RsaKeyPool::RsaKeyPool: cannot write the pool file";
+    }
+
+    // Start out full, whatever the watermarks
+    refillingKeys = keys.size() < highWatermark;
+    refillingSafePrimes = safePrimes.size() < highWatermark;
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+    for (unsigned int i = 0; i < threads; ++i)
+        workers.push_back(std::thread(&RsaKeyPool::run, this));
+}
+
+RsaKeyPool::~RsaKeyPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    changed.notify_all();
+    for (unsigned int i = 0; i < workers.size(); ++i)
+        workers[i].join();
+    save();
+}
+
+bool RsaKeyPool::needKey() const {
+    return refillingKeys && keys.size() + keysInProgress < highWatermark;
+}
+
+bool RsaKeyPool::needSafePrime() const {
+    return safePrimeBits != 0 && refillingSafePrimes
+        && safePrimes.size() + safePrimesInProgress < highWatermark;
+}
+
+void RsaKeyPool::run() {
+    lowerPriority();
+    std::random_device source;
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        while (!stopping && !needKey() && !needSafePrime())
+            changed.wait(guard);
+        if (stopping)
+            return;
+        // The lines are made without the lock, and the ids given with it
+        if (needKey()) {
+            ++keysInProgress;
+            guard.unlock();
+            RsaPrivateKey key = RsaPrivateKey::generate(bits, primeCount, e, 1);
+            std::string fields = keyFields(key);
+            guard.lock();
+            --keysInProgress;
+            unsigned long id = nextId++;
+            std::ostringstream line;
+            line << "key " << id << ' ' << fields;
+            keys.push_back(Key(id, key, line.str()));
+            if (keys.size() >= highWatermark)
+                refillingKeys = false;
+        } else {
+            ++safePrimesInProgress;
+            guard.unlock();
+            BigUnsigned prime = randomSafePrime(source, safePrimeBits,
+                    &stopping);
+            std::string hex = toHex(prime);
+            guard.lock();
+            --safePrimesInProgress;
+            if (prime.isZero())
+                continue;
+            unsigned long id = nextId++;
+            std::ostringstream line;
+            line << "safe " << id << ' ' << hex;
+            safePrimes.push_back(SafePrime(id, prime, line.str()));
+            if (safePrimes.size() >= highWatermark)
+                refillingSafePrimes = false;
+        }
+        changed.notify_all();
+        guard.unlock();
+        save();
+        guard.lock();
+    }
+}
+
+RsaPrivateKey RsaKeyPool::popKey() {
+    std::unique_lock<std::mutex> guard(lock);
+    if (keys.empty()) {
+        guard.unlock();
+        return RsaPrivateKey::generate(bits, primeCount, e, 0);
+    }
+    Key front = std::move(keys.front());
+    keys.pop_front();
+    if (keys.size() < lowWatermark && !refillingKeys) {
+        refillingKeys = true;
+        changed.notify_all();
+    }
+    guard.unlock();
+    if (!markTaken(front.id)) {
+        // Not handed out after all, so it may stay
+        guard.lock();
+        keys.push_front(std::move(front));
+        throw "RsaKeyPool::popKey: cannot record the key as taken";
+    }
+    return std::move(front.key);
+}
+
+BigUnsigned RsaKeyPool::popSafePrime() {
+    if (safePrimeBits == 0)
+        throw "RsaKeyPool::popSafePrime: the pool keeps no safe primes";
+    std::unique_lock<std::mutex> guard(lock);
+    if (safePrimes.empty()) {
+        guard.unlock();
+        std::random_device source;
+        return randomSafePrime(source, safePrimeBits, NULL);
+    }
+    SafePrime front = std::move(safePrimes.front());
+    safePrimes.pop_front();
+    if (safePrimes.size() < lowWatermark && !refillingSafePrimes) {
+        refillingSafePrimes = true;
+        changed.notify_all();
+    }
+    guard.unlock();
+    if (!markTaken(front.id)) {
+        guard.lock();
+        safePrimes.push_front(std::move(front));
+        throw "RsaKeyPool::popSafePrime: cannot record the prime as taken";
+    }
+    return front.prime;
+}
+
+unsigned int RsaKeyPool::keysReady() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return keys.size();
+}
+
+unsigned int RsaKeyPool::safePrimesReady() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return safePrimes.size();
+}
+
+/* Between the watermarks the threads rest, so whatever is short is set
+ * refilling first
+ */
+void RsaKeyPool::waitUntilFull() {
+    std::unique_lock<std::mutex> guard(lock);
+    if (keys.size() < highWatermark)
+        refillingKeys = true;
+    if (safePrimeBits != 0 && safePrimes.size() < highWatermark)
+        refillingSafePrimes = true;
+    changed.notify_all();
+    while (!stopping && (keys.size() < highWatermark
+            || (safePrimeBits != 0 && safePrimes.size() < highWatermark)))
+        changed.wait(guard);
+}
+
+// THE FILE
+// A header line naming the settings, then one line for each key or prime,
+// and one for each taken since the file was last rewritten:
+//     key <id> <p> <q> <dP> <dQ> <qInv> [<prime> <exponent> <coefficient>]...
+//     safe <id> <prime>
+//     taken <id>
+// with the numbers in hexadecimal.
+
+std::string RsaKeyPool::header() const {
+    std::ostringstream out;
+    out << "RsaKeyPool 1 " << bits << ' ' << primeCount << ' ' << e << ' '
+        << safePrimeBits;
+    return out.str();
+}
+
+/* Lines that do not parse, or hold a key that does not work, are dropped:
+ * whatever the pool hands out, it made itself
+ */
+void RsaKeyPool::load() {
+    std::ifstream in(path.c_str());
+    std::string line;
+    if (!std::getline(in, line) || line != header())
+        return;
+    std::set<unsigned long> taken;
+    while (std::getline(in, line)) {
+        std::istringstream words(line);
+        std::string type, word;
+        unsigned long id;
+        if (!(words >> type >> id))
+            continue;
+        if (id >= nextId)
+            nextId = id + 1;
+        std::vector<BigUnsigned> numbers;
+        try {
+            while (words >> word)
+                numbers.push_back(fromHex(word));
+        } catch (const char *) {
+            continue;
+        }
+        if (type == "taken") {
+            taken.insert(id);
+        } else if (type == "key") {
+            if (numbers.size() != 5 + 3 * (primeCount - 2))
+                continue;
+            // Added as generate adds them, then checked by a round trip
+            RsaPrivateKey key;
+            try {
+                key.addFactor(numbers[1], numbers[3], NULL);
+                key.addFactor(numbers[0], numbers[2], &numbers[4]);
+                for (unsigned int i = 5; i < numbers.size(); i += 3)
+                    key.addFactor(numbers[i], numbers[i + 1], &numbers[i + 2]);
+                BigUnsigned m(2), n = key.getModulus();
+                if (n.bitLength() != bits
+                        || key.decrypt(modPow(m, BigUnsigned(e), n)) != m)
+                    continue;
+            } catch (const char *) {
+                continue;
+            }
+            keys.push_back(Key(id, key, line));
+        } else if (type == "safe") {
+            if (numbers.size() != 1 || numbers[0].bitLength() != safePrimeBits
+                    || !isProbablePrime(numbers[0])
+                    || !isProbablePrime(numbers[0] >> 1))
+                continue;
+            safePrimes.push_back(SafePrime(id, numbers[0], line));
+        }
+    }
+
+    std::deque<Key> keptKeys;
+    for (unsigned int i = 0; i < keys.size(); ++i)
+        if (taken.count(keys[i].id) == 0)
+            keptKeys.push_back(keys[i]);
+    keys.swap(keptKeys);
+    std::deque<SafePrime> keptPrimes;
+    for (unsigned int i = 0; i < safePrimes.size(); ++i)
+        if (taken.count(safePrimes[i].id) == 0)
+            keptPrimes.push_back(safePrimes[i]);
+    safePrimes.swap(keptPrimes);
+}
+
+/* The new file is made readable by its owner alone, as the keys in it need,
+ * and reaches the disk before it replaces the old one, which its directory
+ * entry does after
+ */
+bool RsaKeyPool::save() {
+    if (path.empty())
+        return true;
+    // The file lock first: a key taken after the copy below has its taken
+    // line appended to the new file, not the old one
+    std::lock_guard<std::mutex> fileGuard(fileLock);
+    std::string contents = header() + '\n';
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (unsigned int i = 0; i < keys.size(); ++i)
+            contents += keys[i].line + '\n';
+        for (unsigned int i = 0; i < safePrimes.size(); ++i)
+            contents += safePrimes[i].line + '\n';
+    }
+    std::string temporary = path + ".new";
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+        return false;
+    bool written = writeAll(fd, contents) && fsync(fd) == 0;
+    if (close(fd) != 0 || !written) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0
+        && syncDirectory(path);
+}
+
+bool RsaKeyPool::markTaken(unsigned long id) {
+    if (path.empty())
+        return true;
+    std::lock_guard<std::mutex> fileGuard(fileLock);
+    int fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0600);
+    if (fd < 0)
+        return false;
+    std::ostringstream line;
+    line << "taken " << id << '\n';
+    bool written = writeAll(fd, line.str()) && fsync(fd) == 0;
+    return (close(fd) == 0) && written;
+}
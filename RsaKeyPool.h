@@ -0,0 +1,130 @@
+#ifndef RSAKEYPOOL_H
+#define RSAKEYPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BigUnsigned.h"
+#include "RsaPrivateKey.h"
+
+/* An RsaKeyPool makes RSA keys, and safe primes if asked to, ahead of time
+ * on background threads at the lowest scheduling priority, so that handing
+ * one out is a pop off the front of a queue. Once fewer than the low
+ * watermark are ready, the threads make more until there are as many as the
+ * high watermark, and then rest.
+ *
+ * With a file, the pool lasts across restarts: it loads what the file holds
+ * when made, rewrites the file after each new key or prime and when
+ * destroyed, and appends a line to it for each one handed out, so that no
+ * key is handed out twice even if the process dies before the next rewrite.
+ * The file holds private keys and needs protecting as they do; the pool
+ * makes it readable by its owner alone.
+ */
+class RsaKeyPool {
+
+    public:
+        typedef RsaPrivateKey::Blk   Blk;
+        typedef RsaPrivateKey::Index Index;
+
+        /* Keys as from RsaPrivateKey::generate(bits, primeCount, e), kept
+         * between the watermarks by the given number of threads, and safe
+         * primes of safePrimeBits bits between the same watermarks unless
+         * that is 0. An empty path keeps the pool in memory alone; a file
+         * made for other settings is started afresh. Throws an exception if
+         * the watermarks are out of order, the high one is 0, or the key
+         * settings are ones generate would refuse.
+         */
+        RsaKeyPool(Index bits, unsigned int lowWatermark,
+                unsigned int highWatermark, const std::string &path = "",
+                unsigned int threads = 1, Index safePrimeBits = 0,
+                unsigned int primeCount = 2, Blk e = 65537);
+        /* Stops the threads, after the keys they are making, and saves */
+        ~RsaKeyPool();
+
+        /* A ready key, or when there is none, one made on the spot. Throws
+         * an exception, and keeps the key, if it cannot be recorded in the
+         * file as taken.
+         */
+        RsaPrivateKey popKey();
+        /* Likewise for a safe prime. Also throws an exception if the pool
+         * does not keep them.
+         */
+        BigUnsigned popSafePrime();
+
+        unsigned int keysReady() const;
+        unsigned int safePrimesReady() const;
+        /* Refills the pool to the high watermark, even from above the low
+         * one, and blocks until it has
+         */
+        void waitUntilFull();
+
+    private:
+        /* A ready key or prime, with its line in the file, made once so
+         * that saving only has to join the lines up
+         */
+        struct Key {
+            unsigned long id;
+            RsaPrivateKey key;
+            std::string line;
+            Key(unsigned long id, const RsaPrivateKey &key,
+                    const std::string &line)
+                : id(id), key(key), line(line) {}
+        };
+        struct SafePrime {
+            unsigned long id;
+            BigUnsigned prime;
+            std::string line;
+            SafePrime(unsigned long id, const BigUnsigned &prime,
+                    const std::string &line)
+                : id(id), prime(prime), line(line) {}
+        };
+
+        const Index bits, safePrimeBits;
+        const unsigned int lowWatermark, highWatermark, primeCount;
+        const Blk e;
+        const std::string path;
+
+        // All of the below under lock; changes wake the threads, and
+        // additions whoever waits for the pool to fill
+        mutable std::mutex lock;
+        mutable std::condition_variable changed;
+        std::deque<Key> keys;
+        std::deque<SafePrime> safePrimes;
+        // Whether each is between falling below the low watermark and
+        // reaching the high one, and how many the threads are making
+        bool refillingKeys, refillingSafePrimes;
+        unsigned int keysInProgress, safePrimesInProgress;
+        // The id for the next key or prime, unique within the file
+        unsigned long nextId;
+        std::atomic<bool> stopping;
+        std::vector<std::thread> workers;
+
+        // Serializes the file's rewrites and appends
+        std::mutex fileLock;
+
+        bool needKey() const;
+        bool needSafePrime() const;
+        /* The body of each thread */
+        void run();
+        void load();
+        /* Rewrites the file, by way of a new one synced to disk and renamed
+         * over it; false if that fails
+         */
+        bool save();
+        /* Records in the file, synced to disk, that the key or prime with
+         * this id is gone; false if that fails
+         */
+        bool markTaken(unsigned long id);
+        /* The first line of the file, which names the settings */
+        std::string header() const;
+
+        // Not copyable
+        RsaKeyPool(const RsaKeyPool &);
+        RsaKeyPool &operator=(const RsaKeyPool &);
+};
+
+#endif
@@ -0,0 +1,346 @@
+#include "RsaPrivateKey.h"
+#include "BigUnsignedAlgorithms.h"
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace {
+
+/* For keys from outside, which generate's own primes need not go through */
+const BigUnsigned &checkPrime(const BigUnsigned &x) {
+    if (!isProbablePrime(x))
+        throw "RsaPrivateKey::RsaPrivateKey: a factor is not prime";
+    return x;
+}
+
+}
+
+RsaPrivateKey::RsaPrivateKey(const BigUnsigned &p, const BigUnsigned &q,
+        const BigUnsigned &dP, const BigUnsigned &dQ, const BigUnsigned &qInv) {
+    addFactor(checkPrime(q), dQ, NULL);
+    addFactor(checkPrime(p), dP, &qInv);
+}
+
+RsaPrivateKey::RsaPrivateKey(const BigUnsigned &p, const BigUnsigned &q,
+        const BigUnsigned &dP, const BigUnsigned &dQ, const BigUnsigned &qInv,
+        const std::vector<OtherPrime> &others) {
+    addFactor(checkPrime(q), dQ, NULL);
+    addFactor(checkPrime(p), dP, &qInv);
+    for (unsigned int i = 0; i < others.size(); ++i)
+        addFactor(checkPrime(others[i].prime), others[i].exponent,
+                &others[i].coefficient);
+}
+
+RsaPrivateKey::RsaPrivateKey(const BigUnsigned &p, const BigUnsigned &q,
+        const BigUnsigned &d) {
+    addFactor(checkPrime(q), d % (q - BigUnsigned(1)), NULL);
+    addFactor(checkPrime(p), d % (p - BigUnsigned(1)), NULL);
+}
+
+RsaPrivateKey::RsaPrivateKey(const std::vector<BigUnsigned> &primes,
+        const BigUnsigned &d) {
+    if (primes.size() < 2)
+        throw "RsaPrivateKey::RsaPrivateKey: a key needs at least two primes";
+    addFactor(checkPrime(primes[1]), d % (primes[1] - BigUnsigned(1)), NULL);
+    addFactor(checkPrime(primes[0]), d % (primes[0] - BigUnsigned(1)), NULL);
+    for (unsigned int i = 2; i < primes.size(); ++i)
+        addFactor(checkPrime(primes[i]), d % (primes[i] - BigUnsigned(1)),
+                NULL);
+}
+
+void RsaPrivateKey::addFactor(const BigUnsigned &prime,
+        const BigUnsigned &exponent, const BigUnsigned *coefficient) {
+    Factor f(prime, exponent);
+    if (factors.empty()) {
+        n = prime;
+        factors.push_back(f);
+        return;
+    }
+    // The inverse of the product so far
+    f.product = n;
+    if (coefficient)
+        f.coefficient = *coefficient;
+    else
+        f.coefficient = modInverse(n, prime);
+    if (f.coefficient >= prime)
+        throw "RsaPrivateKey::RsaPrivateKey: coefficient is not reduced "
+            "modulo its prime";
+    Index k = f.ctx.getLength();
+    f.coefficientMont.allocate(k);
+    f.ctx.toMontgomery(f.coefficientMont.blk, f.coefficient);
+    f.coefficientMont.len = k;
+    n = n * prime;
+    factors.push_back(f);
+}
+
+std::vector<RsaPrivateKey::OtherPrime> RsaPrivateKey::getOtherPrimes() const {
+    std::vector<OtherPrime> others;
+    for (unsigned int i = 2; i < factors.size(); ++i) {
+        OtherPrime r;
+        r.prime = factors[i].ctx.getModulus();
+        r.exponent = factors[i].exponent;
+        r.coefficient = factors[i].coefficient;
+        others.push_back(r);
+    }
+    return others;
+}
+
+BigUnsigned RsaPrivateKey::decrypt(const BigUnsigned &c) const {
+    if (c >= n)
+        throw "RsaPrivateKey::decrypt: input is not below the modulus";
+    Index k = 0;
+    for (unsigned int i = 0; i < factors.size(); ++i)
+        if (factors[i].ctx.getLength() > k)
+            k = factors[i].ctx.getLength();
+    NumberlikeArray<Blk> a(k), t(k);
+
+    const Factor &first = factors[0];
+    BigUnsigned m = first.ctx.modPowConstantTime(c, first.exponent), h;
+    for (unsigned int i = 1; i < factors.size(); ++i) {
+        const Factor &f = factors[i];
+        BigUnsigned mi = f.ctx.modPowConstantTime(c, f.exponent);
+        // m += product (coefficient (mi - m) mod prime), worked out in
+        // Montgomery form, where the context reduces m without dividing and
+        // subMod does not branch on the difference
+        f.ctx.toMontgomery(a.blk, m);
+        f.ctx.toMontgomery(t.blk, mi);
+        f.ctx.subMod(a.blk, t.blk, a.blk);
+        f.ctx.montMul(t.blk, a.blk, f.coefficientMont.blk);
+        f.ctx.fromMontgomery(h, t.blk);
+        m += f.product * h;
+    }
+    return m;
+}
+
+// KEY GENERATION
+
+namespace {
+
+typedef RsaPrivateKey::Blk   Blk;
+typedef RsaPrivateKey::Index Index;
+
+const unsigned int N = 8 * sizeof(Blk);
+
+/* A uniformly random block from the system's entropy source, which yields
+ * unsigned ints. The shift is split in two so that it stays defined when a
+ * block is no wider than an unsigned int.
+ */
+Blk randomBlock(std::random_device &source) {
+    const unsigned int half = 4 * sizeof(unsigned int);
+    Blk x = 0;
+    for (unsigned int i = 0; i < sizeof(Blk); i += sizeof(unsigned int))
+        x = (x << half << half) | source();
+    return x;
+}
+
+/* A random odd number of exactly the given number of bits >= 2, with its
+ * top two bits set so that a product of two such has twice the bits
+ */
+BigUnsigned randomCandidate(std::random_device &source, Index bits) {
+    Index blocks = (bits + N - 1) / N;
+    std::vector<Blk> x(blocks);
+    for (Index i = 0; i < blocks; ++i)
+        x[i] = randomBlock(source);
+    unsigned int top = (bits - 1) % N;
+    Blk mask = (top == N - 1) ? ~Blk(0) : (Blk(1) << (top + 1)) - 1;
+    x[blocks - 1] &= mask;
+    x[blocks - 1] |= Blk(1) << top;
+    if (top > 0)
+        x[blocks - 1] |= Blk(1) << (top - 1);
+    else
+        x[blocks - 2] |= Blk(1) << (N - 1);
+    x[0] |= 1;
+    return BigUnsigned(&x[0], blocks);
+}
+
+/* 1/a mod m, for 0 < a < m prime to m. The Bezout coefficients of the
+ * extended Euclidean algorithm alternate in sign, so only their magnitudes
+ * are tracked.
+ */
+Blk inverseBlock(Blk a, Blk m) {
+    Blk r0 = m, r1 = a, s0 = 0, s1 = 1;
+    bool positive = true;
+    while (r1 != 1) {
+        Blk q = r0 / r1, t = r0 - q * r1;
+        r0 = r1;
+        r1 = t;
+        t = s0 + q * s1;
+        s0 = s1;
+        s1 = t;
+        positive = !positive;
+    }
+    return positive ? s1 : m - s1;
+}
+
+/* A random prime of the given number of bits, prime - 1 prime to e: the
+ * next one up from a random candidate, unless that runs past the top. Zero
+ * if *stop turns true first.
+ */
+BigUnsigned randomPrime(std::random_device &source, Index bits, Blk e,
+        const std::atomic<bool> *stop) {
+    for (;;) {
+        BigUnsigned r = nextProbablePrime(randomCandidate(source, bits), e,
+                stop);
+        if (r.isZero() || r.bitLength() == bits)
+            return r;
+    }
+}
+
+/* The searches of randomPrime run side by side, from a start of their own
+ * each; the first to finish stops the others
+ */
+struct PrimeSearch {
+    Index bits;
+    Blk e;
+    std::atomic<bool> found;
+    std::mutex lock;
+    BigUnsigned prime;
+
+    PrimeSearch(Index bits, Blk e) : bits(bits), e(e), found(false) {}
+};
+
+void searchPrime(PrimeSearch *search) {
+    std::random_device source;
+    BigUnsigned r = randomPrime(source, search->bits, search->e,
+            &search->found);
+    std::lock_guard<std::mutex> guard(search->lock);
+    if (!r.isZero() && !search->found) {
+        search->prime = r;
+        search->found = true;
+    }
+}
+
+BigUnsigned parallelRandomPrime(std::random_device &source, Index bits,
+        Blk e, unsigned int threads) {
+    if (threads <= 1)
+        return randomPrime(source, bits, e, NULL);
+    PrimeSearch search(bits, e);
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < threads; ++i)
+        workers.push_back(std::thread(searchPrime, &search));
+    searchPrime(&search);
+    for (unsigned int i = 0; i < workers.size(); ++i)
+        workers[i].join();
+    return search.prime;
+}
+
+/* 0 threads means one for each hardware thread */
+unsigned int threadCount(unsigned int threads) {
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    return (threads == 0) ? 1 : threads;
+}
+
+/* d = 1/e mod (r - 1) = (1 + k (r - 1)) / e, where k (r - 1) = -1 mod e */
+BigUnsigned inverseExponent(Blk e, const BigUnsigned &r) {
+    BigUnsigned rm1 = r - BigUnsigned(1);
+    Blk k = e - inverseBlock(rm1.remainderBySmall(e), e);
+    BigUnsigned d = BigUnsigned(k) * rm1 + BigUnsigned(1);
+    d.divideBySmall(e);
+    return d;
+}
+
+}
+
+RsaPrivateKey RsaPrivateKey::generate(Index bits, unsigned int primeCount,
+        Blk e, unsigned int threads) {
+    if (primeCount < 2 || bits / primeCount < 32)
+        throw "RsaPrivateKey::generate: too few bits for that many primes";
+    if (e <= 1 || e % 2 == 0)
+        throw "RsaPrivateKey::generate: public exponent must be odd and above 1";
+    threads = threadCount(threads);
+    std::random_device source;
+    BigUnsigned least = BigUnsigned(1) << (bits - 1);
+
+    // The top two bits of each prime guarantee the full length for two
+    // primes; with more, the product can come out a bit or two short
+    std::vector<BigUnsigned> primes;
+    BigUnsigned n;
+    do {
+        primes.clear();
+        n = BigUnsigned(1);
+        Index remaining = bits;
+        for (unsigned int i = 0; i < primeCount; ++i) {
+            Index b = remaining / (primeCount - i);
+            remaining -= b;
+            BigUnsigned r;
+            bool distinct;
+            do {
+                r = parallelRandomPrime(source, b, e, threads);
+                distinct = true;
+                for (unsigned int j = 0; j < primes.size(); ++j)
+                    distinct = distinct && primes[j] != r;
+            } while (!distinct);
+            primes.push_back(r);
+            n = n * r;
+        }
+    } while (n < least);
+
+    RsaPrivateKey key;
+    key.addFactor(primes[1], inverseExponent(e, primes[1]), NULL);
+    key.addFactor(primes[0], inverseExponent(e, primes[0]), NULL);
+    for (unsigned int i = 2; i < primeCount; ++i)
+        key.addFactor(primes[i], inverseExponent(e, primes[i]), NULL);
+    return key;
+}
+
+namespace {
+
+/* Keys handed out one at a time to the threads of generateMany */
+struct KeyBatch {
+    RsaPrivateKey::Index bits;
+    unsigned int primeCount;
+    RsaPrivateKey::Blk e;
+    // Goes below zero once all are claimed
+    std::atomic<long> remaining;
+    std::vector<RsaPrivateKey> keys;
+    std::mutex lock;
+
+    KeyBatch(RsaPrivateKey::Index bits, unsigned int primeCount,
+            RsaPrivateKey::Blk e, unsigned int count)
+        : bits(bits), primeCount(primeCount), e(e), remaining(count) {}
+};
+
+void generateKeys(KeyBatch *batch) {
+    // Claim a key before making it, so no more than the count get made
+    while (batch->remaining.fetch_sub(1) > 0) {
+        RsaPrivateKey key = RsaPrivateKey::generate(batch->bits,
+                batch->primeCount, batch->e, 1);
+        std::lock_guard<std::mutex> guard(batch->lock);
+        batch->keys.push_back(key);
+    }
+}
+
+}
+
+std::vector<RsaPrivateKey> RsaPrivateKey::generateMany(unsigned int count,
+        Index bits, unsigned int primeCount, Blk e, unsigned int threads,
+        double *keysPerSecond) {
+    // Check the arguments here, where the exception can reach the caller
+    if (primeCount < 2 || bits / primeCount < 32)
+        throw "RsaPrivateKey::generateMany: too few bits for that many primes";
+    if (e <= 1 || e % 2 == 0)
+        throw "RsaPrivateKey::generateMany: public exponent must be odd and "
+            "above 1";
+    threads = threadCount(threads);
+    if (threads > count)
+        threads = (count == 0) ? 1 : count;
+
+    std::chrono::steady_clock::time_point begin =
+        std::chrono::steady_clock::now();
+    KeyBatch batch(bits, primeCount, e, count);
+    batch.keys.reserve(count);
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < threads; ++i)
+        workers.push_back(std::thread(generateKeys, &batch));
+    generateKeys(&batch);
+    for (unsigned int i = 0; i < workers.size(); ++i)
+        workers[i].join();
+    if (keysPerSecond) {
+        std::chrono::duration<double> seconds =
+            std::chrono::steady_clock::now() - begin;
+        *keysPerSecond = (seconds.count() > 0) ? count / seconds.count() : 0;
+    }
+    return batch.keys;
+}
@@ -0,0 +1,121 @@
+#ifndef RSAPRIVATEKEY_H
+#define RSAPRIVATEKEY_H
+
+#include <vector>
+#include "BigUnsigned.h"
+#include "MontgomeryContext.h"
+
+/* An RSA private key in the Chinese remainder form of PKCS #1 (RFC 8017):
+ * the primes p and q, the exponents dP = d mod (p - 1) and dQ = d mod
+ * (q - 1), and qInv = 1/q mod p, plus for a multi-prime key any number of
+ * further primes r_i with their exponents d_i = d mod (r_i - 1) and
+ * coefficients t_i = 1/(p q r_3 ... r_(i-1)) mod r_i.
+ *
+ * The private operation exponentiates modulo each prime separately, with
+ * exponents and moduli a fraction of the size of d and n, and recombines the
+ * results with Garner's formula, one prime at a time:
+ *   m = m_q + q (qInv (m_p - m_q) mod p),
+ *   m = m + p q ... r_(i-1) (t_i (m_i - m) mod r_i).
+ * Two primes are three to four times faster than one exponentiation modulo
+ * n; three and four primes of a 4096-bit key save about as much again.
+ *
+ * The key builds a MontgomeryContext for each prime once, at construction,
+ * and only reads them afterwards, so one key may serve several threads.
+ * The exponentiations are the constant-time ones.
+ */
+class RsaPrivateKey {
+
+    public:
+        typedef BigUnsigned::Blk   Blk;
+        typedef BigUnsigned::Index Index;
+
+        /* A third or later prime, like RFC 8017's OtherPrimeInfo */
+        struct OtherPrime {
+            BigUnsigned prime, exponent, coefficient;
+        };
+
+        /* From the five PKCS #1 components, and for a multi-prime key the
+         * further primes. Throws an exception if a prime fails
+         * isProbablePrime or a coefficient is not below its prime.
+         */
+        RsaPrivateKey(const BigUnsigned &p, const BigUnsigned &q,
+                const BigUnsigned &dP, const BigUnsigned &dQ,
+                const BigUnsigned &qInv);
+        RsaPrivateKey(const BigUnsigned &p, const BigUnsigned &q,
+                const BigUnsigned &dP, const BigUnsigned &dQ,
+                const BigUnsigned &qInv, const std::vector<OtherPrime> &others);
+
+        /* From the primes, p and q first, and the private exponent d, with
+         * the coefficients computed by modInverse. Throws an exception if
+         * there are fewer than two primes, one fails isProbablePrime or two
+         * are the same.
+         */
+        RsaPrivateKey(const BigUnsigned &p, const BigUnsigned &q,
+                const BigUnsigned &d);
+        RsaPrivateKey(const std::vector<BigUnsigned> &primes,
+                const BigUnsigned &d);
+
+        /* Generates a key with a modulus of exactly the given number of bits
+         * made of the given number of primes, of about equal size, for the
+         * public exponent e, which must be odd and above 1. The search for
+         * each prime runs on the given number of threads, 0 meaning one for
+         * each hardware thread, from a random start of their own each; the
+         * first to find one calls off the others. Throws an exception if
+         * there are fewer than two primes or too few bits for them.
+         */
+        static RsaPrivateKey generate(Index bits, unsigned int primeCount = 2,
+                Blk e = 65537, unsigned int threads = 1);
+
+        /* Generates count keys as generate does, on the given number of
+         * threads, each making whole keys one at a time, which keeps them
+         * all busy to the end and so scales with the threads better than
+         * splitting the search for each prime. Stores the keys made per
+         * second of wall-clock time at keysPerSecond, if given.
+         */
+        static std::vector<RsaPrivateKey> generateMany(unsigned int count,
+                Index bits, unsigned int primeCount = 2, Blk e = 65537,
+                unsigned int threads = 0, double *keysPerSecond = NULL);
+
+        const BigUnsigned &getModulus() const { return n; }
+        unsigned int getPrimeCount() const { return factors.size(); }
+        const BigUnsigned &getP() const { return factors[1].ctx.getModulus(); }
+        const BigUnsigned &getQ() const { return factors[0].ctx.getModulus(); }
+        const BigUnsigned &getDP() const { return factors[1].exponent; }
+        const BigUnsigned &getDQ() const { return factors[0].exponent; }
+        const BigUnsigned &getQInv() const { return factors[1].coefficient; }
+        std::vector<OtherPrime> getOtherPrimes() const;
+
+        /* c^d mod n. Throws an exception if c is not below n. Signing is the
+         * same operation on the encoded message.
+         */
+        BigUnsigned decrypt(const BigUnsigned &c) const;
+        BigUnsigned sign(const BigUnsigned &m) const { return decrypt(m); }
+
+    private:
+        /* One prime, in the order of recombination: q, p, r_3, r_4, ... The
+         * coefficient is the inverse modulo this prime of the product of
+         * those before it, and is kept in Montgomery form too.
+         */
+        struct Factor {
+            MontgomeryContext ctx;
+            BigUnsigned exponent, coefficient, product;
+            NumberlikeArray<Blk> coefficientMont;
+
+            Factor(const BigUnsigned &prime, const BigUnsigned &exponent)
+                : ctx(prime), exponent(exponent) {}
+        };
+        std::vector<Factor> factors;
+        BigUnsigned n;
+
+        /* For generate, which adds the primes itself, and RsaKeyPool,
+         * which does the same for the keys it keeps
+         */
+        RsaPrivateKey() {}
+        friend class RsaKeyPool;
+
+        /* Appends a prime; a NULL coefficient means compute it */
+        void addFactor(const BigUnsigned &prime, const BigUnsigned &exponent,
+                const BigUnsigned *coefficient);
+};
+
+#endif
@@ -0,0 +1,14 @@
+#include "RsaPublicKey.h"
+
+RsaPublicKey::RsaPublicKey(const BigUnsigned &n, const BigUnsigned &e)
+        : ctx(n), e(e) {
+    if (e <= BigUnsigned(1) || e.remainderBySmall(2) == 0)
+        throw "RsaPublicKey::RsaPublicKey: public exponent must be odd and "
+            "above 1";
+}
+
+BigUnsigned RsaPublicKey::encrypt(const BigUnsigned &m) const {
+    if (m >= ctx.getModulus())
+        throw "RsaPublicKey::encrypt: input is not below the modulus";
+    return ctx.modPow(m, e);
+}
@@ -0,0 +1,37 @@
+#ifndef RSAPUBLICKEY_H
+#define RSAPUBLICKEY_H
+
+#include "BigUnsigned.h"
+#include "MontgomeryContext.h"
+
+/* An RSA public key: the modulus n and the public exponent e. The key keeps
+ * a MontgomeryContext for n, so encrypting to the same recipient again, or
+ * verifying another signature, pays for the setup only once. For the usual
+ * exponents, such as 65537, the exponentiation is a chain of squarings and a
+ * final multiplication, without the window table.
+ *
+ * Like RsaPrivateKey, a key only reads its context after construction and
+ * may serve several threads.
+ */
+class RsaPublicKey {
+
+    public:
+        /* Throws an exception if n is even or e is not odd and above 1 */
+        RsaPublicKey(const BigUnsigned &n, const BigUnsigned &e);
+
+        const BigUnsigned &getModulus() const { return ctx.getModulus(); }
+        const BigUnsigned &getExponent() const { return e; }
+
+        /* m^e mod n. Throws an exception if m is not below n. Verifying a
+         * signature is the same operation, which recovers the encoded
+         * message.
+         */
+        BigUnsigned encrypt(const BigUnsigned &m) const;
+        BigUnsigned verify(const BigUnsigned &s) const { return encrypt(s); }
+
+    private:
+        MontgomeryContext ctx;
+        BigUnsigned e;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "gtest/include/gtest/gtest.h"
+#include "../BarrettContext.h"
+#include "TestUtil.h"
+#include <vector>
+
+TEST(BarrettContextTest, SmallModulus) {
+    EXPECT_ANY_THROW(BarrettContext(BigUnsigned(0)));
+
+    BarrettContext ctx(BigUnsigned(97));
+    EXPECT_EQ(97, ctx.getModulus().toInt());
+    EXPECT_EQ(0, ctx.reduce(BigUnsigned(0)).toInt());
+    EXPECT_EQ(96, ctx.reduce(BigUnsigned(96)).toInt());
+    EXPECT_EQ(0, ctx.reduce(BigUnsigned(97)).toInt());
+    EXPECT_EQ(30, ctx.reduce(BigUnsigned(1000)).toInt());
+    EXPECT_EQ(90, ctx.mulMod(BigUnsigned(50), BigUnsigned(60)).toInt());
+    EXPECT_TRUE(ctx.mulMod(BigUnsigned(0), BigUnsigned(60)).isZero());
+
+    /* Aliased results */
+    BigUnsigned a(1000);
+    ctx.reduce(a, a);
+    EXPECT_EQ(30, a.toInt());
+    BigUnsigned b(60);
+    ctx.mulMod(b, b, b);
+    EXPECT_EQ(3600 % 97, b.toInt());
+
+    /* Operands longer than the modulus */
+    BigUnsigned::Blk two[] = {1, 1};
+    EXPECT_ANY_THROW(ctx.mulMod(BigUnsigned(two, 2), b));
+}
+
+TEST(BarrettContextTest, MatchesDivision) {
+    const BigUnsigned::Index sizes[] = {1, 2, 3, 8, 16, 33, 64};
+    unsigned long long seed = 9600629759793949339ULL;
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        BigUnsigned::Index k = sizes[i];
+        BigUnsigned m = randomBigUnsigned(k, seed);
+        /* A power of B, whose mu is one block longer than usual, and an
+         * all-ones modulus */
+        std::vector<BigUnsigned::Blk> blocks(k, 0);
+        blocks[k - 1] = 1;
+        BigUnsigned power(&blocks[0], k);
+        std::vector<BigUnsigned::Blk> ones(k, ~BigUnsigned::Blk(0));
+        BigUnsigned allOnes(&ones[0], k);
+        const BigUnsigned moduli[] = {m, power, allOnes};
+        for (unsigned int j = 0; j < 3; ++j) {
+            BarrettContext ctx(moduli[j]);
+            BigUnsigned r;
+            for (BigUnsigned::Index xn = 1; xn <= 2 * k + 1; xn += (k + 3) / 4) {
+                BigUnsigned x = randomBigUnsigned(xn, seed);
+                ctx.reduce(r, x);
+                EXPECT_TRUE(r == x % moduli[j]) << k << " " << j << " " << xn;
+            }
+            BigUnsigned a = randomBigUnsigned(k, seed) % moduli[j];
+            BigUnsigned b = randomBigUnsigned(k, seed) % moduli[j];
+            ctx.mulMod(r, a, b);
+            EXPECT_TRUE(r == a * b % moduli[j]) << k << " " << j;
+            BigUnsigned largest = moduli[j] - BigUnsigned(1);
+            ctx.mulMod(r, largest, largest);
+            EXPECT_TRUE(r == largest * largest % moduli[j]) << k << " " << j;
+        }
+    }
+}
+
+TEST(BarrettContextTest, ToomModulus) {
+    /* Past toom3Threshold, where the scratch multiplyBlocks wants for
+     * m times a short q3 can exceed what it wants for full length */
+    unsigned long long seed = 1442695040888963407ULL;
+    BigUnsigned::Index k = BigUnsigned::toom3Threshold + 1;
+    BigUnsigned m = randomBigUnsigned(k, seed);
+    BarrettContext ctx(m);
+    BigUnsigned r;
+    for (BigUnsigned::Index xn = k; xn < 2 * k; xn += 7) {
+        BigUnsigned x = randomBigUnsigned(xn, seed);
+        ctx.reduce(r, x);
+        EXPECT_TRUE(r == x % m) << xn;
+    }
+    for (BigUnsigned::Index an = 1; an < k; an += 29) {
+        BigUnsigned a = randomBigUnsigned(an, seed);
+        BigUnsigned b = randomBigUnsigned(k, seed) % m;
+        ctx.mulMod(r, a, b);
+        EXPECT_TRUE(r == a * b % m) << an;
+    }
+}
@@ -0,0 +1,485 @@
+#include "gtest/include/gtest/gtest.h"
+#include "../BigUnsignedAlgorithms.h"
+#include "TestUtil.h"
+#include <vector>
+
+/* 2^bits - 1 */
+static BigUnsigned mersenne(unsigned int bits) {
+    return (BigUnsigned(1) << bits) - BigUnsigned(1);
+}
+
+/* base^exp mod m by plain square and multiply, exp given as a small number */
+static BigUnsigned slowPow(const BigUnsigned &base, unsigned long exp,
+        const BigUnsigned &m) {
+    BigUnsigned r = BigUnsigned(1) % m, b = base % m;
+    for (; exp != 0; exp >>= 1) {
+        if (exp & 1)
+            r = r * b % m;
+        b = b * b % m;
+    }
+    return r;
+}
+
+TEST(BigUnsignedAlgorithmsTest, ModPowSmall) {
+    EXPECT_EQ(445, modPow(BigUnsigned(4), BigUnsigned(13), BigUnsigned(497)).toInt());
+    EXPECT_EQ(1, modPow(BigUnsigned(4), BigUnsigned(0), BigUnsigned(497)).toInt());
+    EXPECT_EQ(0, modPow(BigUnsigned(0), BigUnsigned(5), BigUnsigned(497)).toInt());
+    EXPECT_EQ(0, modPow(BigUnsigned(7), BigUnsigned(0), BigUnsigned(1)).toInt());
+    // Even moduli
+    EXPECT_EQ(24, modPow(BigUnsigned(2), BigUnsigned(10), BigUnsigned(1000)).toInt());
+    EXPECT_EQ(1, modPow(BigUnsigned(3), BigUnsigned(0), BigUnsigned(4)).toInt());
+    EXPECT_ANY_THROW(modPow(BigUnsigned(2), BigUnsigned(3), BigUnsigned(0)));
+}
+
+TEST(BigUnsignedAlgorithmsTest, ModPowFermat) {
+    // 2^127 - 1 and 2^521 - 1 are prime
+    const unsigned int exponents[] = {127, 521};
+    unsigned long long seed = 88172645463325252ULL;
+    for (unsigned int i = 0; i < 2; ++i) {
+        BigUnsigned p = mersenne(exponents[i]);
+        BigUnsigned a = randomBigUnsigned(3, seed) % p;
+        EXPECT_TRUE(modPow(a, p - BigUnsigned(1), p) == BigUnsigned(1));
+        EXPECT_TRUE(modPow(a, p, p) == a);
+    }
+}
+
+TEST(BigUnsignedAlgorithmsTest, ModPowMatchesSquareAndMultiply) {
+    const BigUnsigned::Index sizes[] = {1, 2, 5, 16, 33};
+    unsigned long long seed = 2463534242ULL;
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        BigUnsigned m = randomBigUnsigned(sizes[i], seed);
+        BigUnsigned base = randomBigUnsigned(sizes[i] + 1, seed);
+        // Odd and even moduli, and exponents long enough for every window
+        for (int parity = 0; parity < 2; ++parity) {
+            if (m.remainderBySmall(2) != BigUnsigned::Blk(parity))
+                m = m + BigUnsigned(1);
+            unsigned long exps[] = {1, 2, 3, 65537, 0xffffffffUL,
+                (unsigned long)randomBigUnsigned(1, seed).toUnsignedLong()};
+            for (unsigned int j = 0; j < sizeof(exps) / sizeof(exps[0]); ++j)
+                EXPECT_TRUE(modPow(base, BigUnsigned(exps[j]), m)
+                        == slowPow(base, exps[j], m)) << sizes[i] << " " << exps[j];
+        }
+    }
+    // A long exponent, against a split into two halves
+    BigUnsigned m = randomBigUnsigned(8, seed) * BigUnsigned(2) + BigUnsigned(1);
+    BigUnsigned base = randomBigUnsigned(8, seed);
+    BigUnsigned e1 = randomBigUnsigned(8, seed), e2 = randomBigUnsigned(8, seed);
+    EXPECT_TRUE(modPow(base, e1 + e2, m)
+            == modPow(base, e1, m) * modPow(base, e2, m) % m);
+}
+
+TEST(BigUnsignedAlgorithmsTest, ModPowConstantTimeMatchesModPow) {
+    EXPECT_EQ(445, modPowConstantTime(BigUnsigned(4), BigUnsigned(13), BigUnsigned(497)).toInt());
+    EXPECT_EQ(1, modPowConstantTime(BigUnsigned(4), BigUnsigned(0), BigUnsigned(497)).toInt());
+    EXPECT_EQ(0, modPowConstantTime(BigUnsigned(4), BigUnsigned(9), BigUnsigned(1)).toInt());
+    EXPECT_ANY_THROW(modPowConstantTime(BigUnsigned(2), BigUnsigned(3), BigUnsigned(1000)));
+
+    const BigUnsigned::Index sizes[] = {1, 2, 5, 16, 33};
+    unsigned long long seed = 1181783497276652981ULL;
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        BigUnsigned m = randomBigUnsigned(sizes[i], seed);
+        if (m.remainderBySmall(2) == 0)
+            m = m + BigUnsigned(1);
+        BigUnsigned base = randomBigUnsigned(sizes[i], seed);
+        // Exponents with short, long and all-zero windows
+        const BigUnsigned exps[] = {BigUnsigned(1), BigUnsigned(32),
+            randomBigUnsigned(1, seed), randomBigUnsigned(sizes[i], seed),
+            randomBigUnsigned(3, seed) * BigUnsigned(1024 * 1024)};
+        for (unsigned int j = 0; j < sizeof(exps) / sizeof(exps[0]); ++j)
+            EXPECT_TRUE(modPowConstantTime(base, exps[j], m)
+                    == modPow(base, exps[j], m)) << sizes[i] << " " << j;
+    }
+}
+
+/* Euclid's algorithm with plain remainders */
+static BigUnsigned slowGcd(BigUnsigned a, BigUnsigned b) {
+    while (!b.isZero()) {
+        BigUnsigned r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+TEST(BigUnsignedAlgorithmsTest, GcdSmall) {
+    EXPECT_EQ(6, gcd(BigUnsigned(48), BigUnsigned(18)).toInt());
+    EXPECT_EQ(6, gcd(BigUnsigned(18), BigUnsigned(48)).toInt());
+    EXPECT_EQ(1, gcd(BigUnsigned(17), BigUnsigned(5)).toInt());
+    EXPECT_EQ(5, gcd(BigUnsigned(0), BigUnsigned(5)).toInt());
+    EXPECT_EQ(5, gcd(BigUnsigned(5), BigUnsigned(0)).toInt());
+    EXPECT_TRUE(gcd(BigUnsigned(0), BigUnsigned(0)).isZero());
+    EXPECT_EQ(1024, gcd(BigUnsigned(1024), BigUnsigned(3072)).toInt());
+    // 2^127 - 1 and 2^89 - 1 are prime; a shared power of two crosses blocks
+    BigUnsigned p = mersenne(127), q = mersenne(89), two64 = mersenne(64) + BigUnsigned(1);
+    EXPECT_TRUE(gcd(p * q * two64, q * two64 * two64) == q * two64);
+    EXPECT_TRUE(gcd(p, q) == BigUnsigned(1));
+    EXPECT_TRUE(gcd(p, p) == p);
+}
+
+TEST(BigUnsignedAlgorithmsTest, GcdMatchesEuclid) {
+    const BigUnsigned::Index saved = BigUnsigned::lehmerThreshold;
+    // Lehmer from two blocks up, and binary throughout
+    const BigUnsigned::Index thresholds[] = {2, 1000};
+    const BigUnsigned::Index sizes[][3] = {
+        {1, 1, 1}, {1, 3, 2}, {2, 2, 3}, {5, 4, 1}, {12, 12, 4},
+        {30, 2, 9}, {40, 38, 1}, {3, 40, 20}};
+    unsigned long long seed = 9876543210123ULL;
+    for (unsigned int t = 0; t < 2; ++t) {
+        BigUnsigned::lehmerThreshold = thresholds[t];
+        for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+            // A common factor, so the answer is not always 1
+            BigUnsigned g = randomBigUnsigned(sizes[i][2], seed);
+            BigUnsigned a = randomBigUnsigned(sizes[i][0], seed) * g;
+            BigUnsigned b = randomBigUnsigned(sizes[i][1], seed) * g;
+            EXPECT_TRUE(gcd(a, b) == slowGcd(a, b)) << t << " " << i;
+            EXPECT_TRUE(gcd(b, a) == slowGcd(a, b)) << t << " " << i;
+            // Consecutive Fibonacci-like worst cases: a and a + b
+            EXPECT_TRUE(gcd(a + b, a) == slowGcd(a + b, a)) << t << " " << i;
+        }
+    }
+    BigUnsigned::lehmerThreshold = saved;
+}
+
+TEST(BigUnsignedAlgorithmsTest, HalfGcdMatchesEuclid) {
+    const BigUnsigned::Index saved = BigUnsigned::halfGcdThreshold;
+    // Small enough thresholds to recurse several levels deep
+    const BigUnsigned::Index thresholds[] = {3, 4, 9};
+    const BigUnsigned::Index sizes[][3] = {
+        {20, 20, 1}, {40, 39, 5}, {64, 64, 30}, {80, 30, 2}, {100, 97, 1},
+        {3, 90, 40}};
+    unsigned long long seed = 1122334455667788ULL;
+    for (unsigned int t = 0; t < 3; ++t) {
+        BigUnsigned::halfGcdThreshold = thresholds[t];
+        for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+            BigUnsigned g = randomBigUnsigned(sizes[i][2], seed);
+            BigUnsigned a = randomBigUnsigned(sizes[i][0], seed) * g;
+            BigUnsigned b = randomBigUnsigned(sizes[i][1], seed) * g;
+            BigUnsigned expected = slowGcd(a, b);
+            EXPECT_TRUE(gcd(a, b) == expected) << t << " " << i;
+            EXPECT_TRUE(gcd(a + b, a) == slowGcd(a + b, a)) << t << " " << i;
+            BigUnsigned x;
+            EXPECT_TRUE(extendedGcd(a, b, x) == expected) << t << " " << i;
+            EXPECT_TRUE(x < b) << t << " " << i;
+            EXPECT_TRUE(a * x % b == expected % b) << t << " " << i;
+        }
+    }
+    BigUnsigned::halfGcdThreshold = saved;
+}
+
+TEST(BigUnsignedAlgorithmsTest, ExtendedGcdSmall) {
+    BigUnsigned x;
+    EXPECT_EQ(1, extendedGcd(BigUnsigned(3), BigUnsigned(7), x).toInt());
+    EXPECT_EQ(5, x.toInt());
+    EXPECT_EQ(6, extendedGcd(BigUnsigned(48), BigUnsigned(18), x).toInt());
+    EXPECT_EQ(48 * x.toInt() % 18, 6);
+    EXPECT_EQ(7, extendedGcd(BigUnsigned(0), BigUnsigned(7), x).toInt());
+    EXPECT_TRUE(x < BigUnsigned(7));
+    EXPECT_EQ(1, extendedGcd(BigUnsigned(5), BigUnsigned(1), x).toInt());
+    EXPECT_TRUE(x.isZero());
+    // 2^127 - 1 is prime, so everything below it has an inverse
+    BigUnsigned p = mersenne(127), a = mersenne(100);
+    EXPECT_TRUE(extendedGcd(a, p, x) == BigUnsigned(1));
+    EXPECT_TRUE(a * x % p == BigUnsigned(1));
+    EXPECT_THROW(extendedGcd(BigUnsigned(3), BigUnsigned(0), x), const char *);
+}
+
+TEST(BigUnsignedAlgorithmsTest, ModInverse) {
+    EXPECT_EQ(5, modInverse(BigUnsigned(3), BigUnsigned(7)).toInt());
+    EXPECT_EQ(5, modInverse(BigUnsigned(10), BigUnsigned(7)).toInt());
+    EXPECT_EQ(7, modInverse(BigUnsigned(3), BigUnsigned(10)).toInt());
+    EXPECT_TRUE(modInverse(BigUnsigned(3), BigUnsigned(1)).isZero());
+    EXPECT_THROW(modInverse(BigUnsigned(6), BigUnsigned(9)), const char *);
+    EXPECT_THROW(modInverse(BigUnsigned(0), BigUnsigned(9)), const char *);
+    EXPECT_THROW(modInverse(BigUnsigned(4), BigUnsigned(10)), const char *);
+    EXPECT_THROW(modInverse(BigUnsigned(3), BigUnsigned(0)), const char *);
+
+    // Both algorithms, on odd and even moduli
+    const BigUnsigned::Index saved = BigUnsigned::binaryInverseThreshold;
+    const BigUnsigned::Index sizes[] = {1, 2, 3, 8, 17};
+    unsigned long long seed = 5647382910564738ULL;
+    for (unsigned int t = 0; t < 2; ++t) {
+        BigUnsigned::binaryInverseThreshold = (t == 0) ? 1000 : 0;
+        for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+            BigUnsigned m = randomBigUnsigned(sizes[i], seed);
+            for (unsigned int parity = 0; parity < 2; ++parity) {
+                if (m.remainderBySmall(2) != parity)
+                    m += BigUnsigned(1);
+                BigUnsigned a = randomBigUnsigned(sizes[i] + 1, seed);
+                while (gcd(a, m) != BigUnsigned(1))
+                    a += BigUnsigned(1);
+                BigUnsigned x = modInverse(a, m);
+                EXPECT_TRUE(x < m) << t << " " << i << " " << parity;
+                EXPECT_TRUE(a * x % m == BigUnsigned(1))
+                    << t << " " << i << " " << parity;
+            }
+        }
+    }
+    BigUnsigned::binaryInverseThreshold = saved;
+}
+
+TEST(BigUnsignedAlgorithmsTest, ModInverseBatch) {
+    BigUnsigned m = mersenne(127);
+    unsigned long long seed = 1029384756ULL;
+    std::vector<BigUnsigned> values;
+    for (unsigned int i = 0; i < 10; ++i)
+        values.push_back(randomBigUnsigned(1 + i % 3, seed));
+    values.push_back(m + BigUnsigned(5));
+    std::vector<BigUnsigned> inverses = values;
+    modInverseBatch(inverses, m);
+    for (unsigned int i = 0; i < values.size(); ++i)
+        EXPECT_TRUE(inverses[i] == modInverse(values[i], m)) << i;
+
+    // A single value, no values, and a value with no inverse
+    std::vector<BigUnsigned> one(1, BigUnsigned(3));
+    modInverseBatch(one, BigUnsigned(7));
+    EXPECT_EQ(5, one[0].toInt());
+    std::vector<BigUnsigned> none;
+    modInverseBatch(none, BigUnsigned(7));
+    EXPECT_TRUE(none.empty());
+    std::vector<BigUnsigned> bad(3, BigUnsigned(3));
+    bad[1] = BigUnsigned(4);
+    EXPECT_THROW(modInverseBatch(bad, BigUnsigned(10)), const char *);
+    EXPECT_EQ(4, bad[1].toInt());
+}
+
+/* Whether r is the k-th root of x, rounded down */
+static bool isRoot(const BigUnsigned &r, const BigUnsigned &x, unsigned int k) {
+    BigUnsigned p(1), q(1), r1 = r + BigUnsigned(1);
+    for (unsigned int i = 0; i < k; ++i) {
+        p = p * r;
+        q = q * r1;
+    }
+    return p <= x && x < q;
+}
+
+TEST(BigUnsignedAlgorithmsTest, Roots) {
+    for (int i = 0; i < 300; ++i)
+        EXPECT_TRUE(isRoot(isqrt(BigUnsigned(i)), BigUnsigned(i), 2)) << i;
+    EXPECT_EQ(4, iroot(BigUnsigned(100), 3).toInt());
+    EXPECT_EQ(1, iroot(BigUnsigned(100), 7).toInt());
+    EXPECT_EQ(100, iroot(BigUnsigned(100), 1).toInt());
+    EXPECT_TRUE(iroot(BigUnsigned(0), 5).isZero());
+    EXPECT_THROW(iroot(BigUnsigned(100), 0), const char *);
+    // The largest block and its neighbours
+    BigUnsigned top(~BigUnsigned::Blk(0));
+    for (unsigned int k = 2; k < 6; ++k) {
+        EXPECT_TRUE(isRoot(iroot(top, k), top, k)) << k;
+        EXPECT_TRUE(isRoot(iroot(top + BigUnsigned(1), k),
+                    top + BigUnsigned(1), k)) << k;
+    }
+
+    // Random values, and perfect powers and their neighbours, on both sides
+    // of the recursion's base cases
+    const unsigned int ks[] = {2, 3, 5, 17, 64, 200};
+    const BigUnsigned::Index sizes[] = {2, 3, 7, 30, 61};
+    unsigned long long seed = 2718281828459045ULL;
+    for (unsigned int i = 0; i < sizeof(ks) / sizeof(ks[0]); ++i)
+        for (unsigned int j = 0; j < sizeof(sizes) / sizeof(sizes[0]); ++j) {
+            unsigned int k = ks[i];
+            BigUnsigned x = randomBigUnsigned(sizes[j], seed);
+            EXPECT_TRUE(isRoot(iroot(x, k), x, k)) << k << " " << sizes[j];
+            BigUnsigned r = iroot(x, k) + BigUnsigned(1), p(1);
+            for (unsigned int l = 0; l < k; ++l)
+                p = p * r;
+            EXPECT_TRUE(iroot(p, k) == r) << k << " " << sizes[j];
+            p -= BigUnsigned(1);
+            EXPECT_TRUE(iroot(p, k) == r - BigUnsigned(1)) << k << " " << sizes[j];
+        }
+}
+
+/* (a/n) from the definition for small n: Euler's criterion modulo each
+ * prime factor, found by trial division */
+static int slowJacobi(unsigned long a, unsigned long n) {
+    int s = 1;
+    for (unsigned long p = 3; n > 1; p += 2)
+        while (n % p == 0) {
+            n /= p;
+            BigUnsigned e = modPow(BigUnsigned(a), BigUnsigned((p - 1) / 2),
+                    BigUnsigned(p));
+            if (e.isZero())
+                return 0;
+            if (e != BigUnsigned(1))
+                s = -s;
+        }
+    return s;
+}
+
+TEST(BigUnsignedAlgorithmsTest, JacobiSmall) {
+    for (unsigned long n = 1; n < 60; n += 2)
+        for (unsigned long a = 0; a < 70; ++a)
+            EXPECT_EQ(slowJacobi(a, n), jacobi(BigUnsigned(a), BigUnsigned(n)))
+                << a << " " << n;
+    EXPECT_THROW(jacobi(BigUnsigned(3), BigUnsigned(10)), const char *);
+    EXPECT_THROW(jacobi(BigUnsigned(3), BigUnsigned(0)), const char *);
+}
+
+TEST(BigUnsignedAlgorithmsTest, JacobiLehmerMatchesBinary) {
+    // Multiplicativity gives the answer for products, with a shared factor
+    // or a square making it 0 or 1
+    const BigUnsigned::Index saved = BigUnsigned::jacobiLehmerThreshold;
+    const BigUnsigned::Index sizes[][2] = {
+        {1, 1}, {3, 2}, {2, 2}, {8, 8}, {20, 3}, {5, 20}, {33, 31}};
+    unsigned long long seed = 3141592653589793ULL;
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        BigUnsigned a = randomBigUnsigned(sizes[i][0], seed);
+        BigUnsigned n = randomBigUnsigned(sizes[i][1], seed);
+        BigUnsigned m = randomBigUnsigned(sizes[i][1], seed);
+        if (n.remainderBySmall(2) == 0)
+            n += BigUnsigned(1);
+        if (m.remainderBySmall(2) == 0)
+            m += BigUnsigned(1);
+        // Even numerators with many factors of two, too
+        BigUnsigned a2 = a * BigUnsigned(1024) * BigUnsigned(1024);
+        BigUnsigned::jacobiLehmerThreshold = 1000;
+        int ja = jacobi(a, n), jm = jacobi(a, m), jn = jacobi(n, m);
+        int j2 = jacobi(a2, n * m);
+        for (unsigned int t = 0; t < 2; ++t) {
+            BigUnsigned::jacobiLehmerThreshold = (t == 0) ? 2 : 1000;
+            EXPECT_EQ(ja, jacobi(a, n)) << i;
+            EXPECT_EQ(ja * jm, jacobi(a, n * m)) << i;
+            EXPECT_EQ(j2, jacobi(a2, n * m)) << i;
+            EXPECT_EQ(jn * jn == 0 ? 0 : 1, jacobi(n * n, m)) << i;
+            EXPECT_EQ(0, jacobi(a * n, n * m)) << i;
+        }
+    }
+    BigUnsigned::jacobiLehmerThreshold = saved;
+}
+
+TEST(BigUnsignedAlgorithmsTest, IsProbablePrimeSmall) {
+    // Below 2^30 trial division alone decides
+    const unsigned int limit = 40000;
+    std::vector<bool> composite(limit);
+    composite[0] = composite[1] = true;
+    for (unsigned int p = 2; p < limit; ++p)
+        if (!composite[p])
+            for (unsigned int q = 2 * p; q < limit; q += p)
+                composite[q] = true;
+    for (unsigned int x = 0; x < limit; ++x)
+        EXPECT_EQ(!composite[x], isProbablePrime(BigUnsigned(x), 0)) << x;
+    EXPECT_FALSE(isProbablePrime(BigUnsigned(32749UL * 32719UL), 0));
+}
+
+TEST(BigUnsignedAlgorithmsTest, IsProbablePrime) {
+    const unsigned int primes[] = {31, 61, 89, 107, 127, 521, 607, 1279};
+    for (unsigned int i = 0; i < sizeof(primes) / sizeof(primes[0]); ++i) {
+        EXPECT_TRUE(isProbablePrime(mersenne(primes[i]), 20)) << primes[i];
+        for (unsigned int j = 0; j < i; ++j)
+            EXPECT_FALSE(isProbablePrime(
+                    mersenne(primes[i]) * mersenne(primes[j]), 1)) << i;
+    }
+    // Both factors of these are past the trial divisors
+    EXPECT_FALSE(isProbablePrime(mersenne(67), 1));
+    EXPECT_FALSE(isProbablePrime(mersenne(101), 1));
+
+    // Carmichael numbers (6k + 1)(12k + 1)(18k + 1), with factors past the
+    // trial divisors, pass Fermat's test to every base prime to them
+    unsigned int found = 0;
+    for (unsigned long k = 6000; found < 3; ++k) {
+        BigUnsigned p(6 * k + 1), q(12 * k + 1), r(18 * k + 1);
+        if (!isProbablePrime(p, 20) || !isProbablePrime(q, 20)
+                || !isProbablePrime(r, 20))
+            continue;
+        BigUnsigned n = p * q * r;
+        EXPECT_TRUE(modPow(BigUnsigned(2), n - BigUnsigned(1), n)
+                == BigUnsigned(1)) << k;
+        EXPECT_FALSE(isProbablePrime(n, 10)) << k;
+        ++found;
+    }
+}
+
+TEST(BigUnsignedAlgorithmsTest, BailliePsw) {
+    for (unsigned int x = 0; x < 5000; ++x)
+        EXPECT_EQ(isProbablePrime(BigUnsigned(x), 0),
+                isProbablePrime(BigUnsigned(x))) << x;
+    const unsigned int primes[] = {31, 61, 89, 107, 127, 521, 607, 1279, 2203};
+    for (unsigned int i = 0; i < sizeof(primes) / sizeof(primes[0]); ++i) {
+        EXPECT_TRUE(isProbablePrime(mersenne(primes[i]))) << primes[i];
+        for (unsigned int j = 0; j < i; ++j)
+            EXPECT_FALSE(isProbablePrime(
+                    mersenne(primes[i]) * mersenne(primes[j]))) << i;
+        // A square, for which no D has (D/x) = -1
+        EXPECT_FALSE(isProbablePrime(mersenne(primes[i]) * mersenne(primes[i])))
+            << i;
+    }
+    // 2^p - 1 passes the strong test to base 2 for every prime p
+    EXPECT_FALSE(isProbablePrime(mersenne(67)));
+    EXPECT_FALSE(isProbablePrime(mersenne(101)));
+    EXPECT_FALSE(isProbablePrime(mersenne(1277)));
+
+    // Strong pseudoprimes to base 2, and Carmichael numbers, past the trial
+    // divisors: 2^p - 1 for composite 2^p - 1 and prime p, and products
+    // (6k + 1)(12k + 1)(18k + 1) of primes
+    unsigned int found = 0;
+    for (unsigned long k = 6000; found < 3; ++k) {
+        BigUnsigned p(6 * k + 1), q(12 * k + 1), r(18 * k + 1);
+        if (!isProbablePrime(p) || !isProbablePrime(q) || !isProbablePrime(r))
+            continue;
+        EXPECT_FALSE(isProbablePrime(p * q * r)) << k;
+        ++found;
+    }
+
+    // Random primes agree with Miller-Rabin, and random odd numbers mostly
+    // fail
+    unsigned long long seed = 271828182845904523ULL;
+    unsigned int seen = 0;
+    while (seen < 10) {
+        BigUnsigned x = randomBigUnsigned(6, seed);
+        if (x.remainderBySmall(2) == 0)
+            x += BigUnsigned(1);
+        bool bpsw = isProbablePrime(x);
+        EXPECT_EQ(isProbablePrime(x, 20), bpsw);
+        seen += bpsw;
+    }
+}
+
+TEST(BigUnsignedAlgorithmsTest, NextProbablePrime) {
+    EXPECT_EQ(2, nextProbablePrime(BigUnsigned(0), 1).toInt());
+    EXPECT_EQ(3, nextProbablePrime(BigUnsigned(3), 1).toInt());
+    EXPECT_EQ(11, nextProbablePrime(BigUnsigned(8), 1).toInt());
+    // 11 - 1 and 13 - 1 share a factor with 15
+    EXPECT_EQ(17, nextProbablePrime(BigUnsigned(8), 15).toInt());
+    EXPECT_ANY_THROW(nextProbablePrime(BigUnsigned(8), 0));
+    // 2^64 - 59 and 2^64 + 13 are the primes either side of 2^64
+    BigUnsigned b64 = BigUnsigned(1) << 64;
+    EXPECT_TRUE(nextProbablePrime(b64 - BigUnsigned(59), 1)
+            == b64 - BigUnsigned(59));
+    EXPECT_TRUE(nextProbablePrime(b64 - BigUnsigned(58), 1)
+            == b64 + BigUnsigned(13));
+
+    // Sieved searches agree with plain ones. The last e, the product of the
+    // odd primes to 47, rules out most primes, so that searches move the
+    // window on.
+    unsigned long long seed = 1618033988749894848ULL;
+    const BigUnsigned::Blk es[] = {1, 3, 65537, 307444891294245705UL};
+    for (unsigned int i = 0; i < 8; ++i) {
+        BigUnsigned x = randomBigUnsigned(1 + i % 4, seed);
+        BigUnsigned::Blk e = es[i % 4];
+        BigUnsigned p = nextProbablePrime(x, e);
+        EXPECT_TRUE(p >= x) << i;
+        EXPECT_TRUE(isProbablePrime(p)) << i;
+        EXPECT_EQ(1u, gcd(p - BigUnsigned(1), BigUnsigned(e)).toUnsignedLong())
+            << i;
+        for (BigUnsigned y = x; y < p; y += BigUnsigned(1))
+            EXPECT_TRUE(!isProbablePrime(y) || gcd(y - BigUnsigned(1),
+                    BigUnsigned(e)) != BigUnsigned(1)) << i;
+    }
+}
+
+TEST(BigUnsignedAlgorithmsTest, NextSafePrime) {
+    const unsigned int safe[] = {5, 7, 11, 23, 47, 59, 83, 107, 167, 179};
+    for (unsigned int i = 0, x = 0; x <= 179; ++x) {
+        if (x > safe[i])
+            ++i;
+        EXPECT_EQ(safe[i], nextSafePrime(BigUnsigned(x)).toUnsignedLong()) << x;
+    }
+    // Sieved searches agree with plain ones
+    unsigned long long seed = 1414213562373095048ULL;
+    for (unsigned int i = 0; i < 3; ++i) {
+        BigUnsigned x = randomBigUnsigned(1 + i % 2, seed) >> 20;
+        BigUnsigned p = nextSafePrime(x);
+        EXPECT_TRUE(p >= x) << i;
+        EXPECT_TRUE(isProbablePrime(p) && isProbablePrime(p >> 1)) << i;
+        for (BigUnsigned y = x; y < p; y += BigUnsigned(1))
+            EXPECT_FALSE(isProbablePrime(y) && isProbablePrime(y >> 1)) << i;
+    }
+}
@@ -1,5 +1,7 @@
 #include "gtest/include/gtest/gtest.h"
 #include "../BigUnsigned.h"
+#include "TestUtil.h"
+#include <vector>
 
 class BigUnsignedTest : public ::testing::Test {
 
@@ -99,3 +101,345 @@ TEST_F(BigUnsignedTest, Operators) {
     EXPECT_TRUE(v2>=v3);
     EXPECT_TRUE(v2!=v1);
 }
+
+TEST_F(BigUnsignedTest, Multiplication) {
+    BigUnsigned zero, six(6), seven(7);
+    EXPECT_TRUE((zero * seven).isZero());
+    EXPECT_TRUE((seven * zero).isZero());
+    EXPECT_EQ(42, (six * seven).toInt());
+
+    /* (B - 1)^2 = (B - 2) B + 1 */
+    BigUnsigned::Blk max[] = {~BigUnsigned::Blk(0)};
+    BigUnsigned::Blk sq[] = {1, ~BigUnsigned::Blk(0) - 1};
+    BigUnsigned m(max, 1);
+    EXPECT_TRUE(m * m == BigUnsigned(sq, 2));
+
+    /* Aliased calls */
+    m.multiply(m, m);
+    EXPECT_TRUE(m == BigUnsigned(sq, 2));
+    six *= seven;
+    EXPECT_EQ(42, six.toInt());
+    seven.multiply(six, seven);
+    EXPECT_EQ(294, seven.toInt());
+}
+
+TEST_F(BigUnsignedTest, KaratsubaMatchesSchoolbook) {
+    const BigUnsigned::Index saved = BigUnsigned::karatsubaThreshold;
+    const BigUnsigned::Index sizes[][2] = {
+        {2, 2}, {3, 3}, {5, 4}, {17, 17}, {40, 39}, {64, 64}, {97, 97},
+        {100, 7}, {130, 40}, {257, 100}
+    };
+    unsigned long long seed = 88172645463325252ULL;
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        BigUnsigned a = randomBigUnsigned(sizes[i][0], seed);
+        BigUnsigned b = randomBigUnsigned(sizes[i][1], seed);
+        BigUnsigned::karatsubaThreshold = 1000000;
+        BigUnsigned expected = a * b;
+        BigUnsigned::karatsubaThreshold = 2;
+        EXPECT_TRUE(a * b == expected) << sizes[i][0] << "x" << sizes[i][1];
+        EXPECT_TRUE(b * a == expected) << sizes[i][1] << "x" << sizes[i][0];
+    }
+    BigUnsigned::karatsubaThreshold = saved;
+}
+
+TEST_F(BigUnsignedTest, ToomCookMatchesSchoolbook) {
+    const BigUnsigned::Index savedK = BigUnsigned::karatsubaThreshold;
+    const BigUnsigned::Index saved3 = BigUnsigned::toom3Threshold;
+    const BigUnsigned::Index saved4 = BigUnsigned::toom4Threshold;
+    const BigUnsigned::Index sizes[][2] = {
+        {7, 7}, {8, 8}, {13, 13}, {19, 19}, {30, 29}, {50, 50}, {99, 99},
+        {200, 31}, {301, 300}
+    };
+    /* Toom-3 alone, Toom-4 over Toom-3, and both with Karatsuba
+     * underneath. Every size reaches Toom-3 at least, since its shorter
+     * operand is at or above each tier's Toom-3 threshold.
+     */
+    const BigUnsigned::Index tiers[][3] = {
+        {1000000, 7, 1000000}, {1000000, 7, 13}, {4, 7, 20}
+    };
+    unsigned long long seed = 2463534242ULL;
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        BigUnsigned a = randomBigUnsigned(sizes[i][0], seed);
+        BigUnsigned b = randomBigUnsigned(sizes[i][1], seed);
+        /* All-ones operands give the largest intermediate values */
+        std::vector<BigUnsigned::Blk> allOnes(sizes[i][0], ~BigUnsigned::Blk(0));
+        BigUnsigned ones(&allOnes[0], sizes[i][0]);
+        BigUnsigned::karatsubaThreshold = 1000000;
+        BigUnsigned::toom3Threshold = 1000000;
+        BigUnsigned::toom4Threshold = 1000000;
+        BigUnsigned expected = a * b, expectedOnes = ones * ones;
+        for (unsigned int t = 0; t < sizeof(tiers) / sizeof(tiers[0]); ++t) {
+            BigUnsigned::karatsubaThreshold = tiers[t][0];
+            BigUnsigned::toom3Threshold = tiers[t][1];
+            BigUnsigned::toom4Threshold = tiers[t][2];
+            ASSERT_GE(sizes[i][1], tiers[t][1]);
+            EXPECT_TRUE(a * b == expected) << sizes[i][0] << "x" << sizes[i][1];
+            EXPECT_TRUE(ones * ones == expectedOnes) << sizes[i][0];
+        }
+    }
+    BigUnsigned::karatsubaThreshold = savedK;
+    BigUnsigned::toom3Threshold = saved3;
+    BigUnsigned::toom4Threshold = saved4;
+}
+
+TEST_F(BigUnsignedTest, NttMatchesToomCook) {
+    const BigUnsigned::Index saved = BigUnsigned::nttThreshold;
+    const BigUnsigned::Index sizes[][2] = {
+        {2, 2}, {5, 2}, {3, 3}, {33, 31}, {64, 64}, {500, 3}, {700, 650}
+    };
+    unsigned long long seed = 0x9E3779B97F4A7C15ULL;
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        BigUnsigned a = randomBigUnsigned(sizes[i][0], seed);
+        BigUnsigned b = randomBigUnsigned(sizes[i][1], seed);
+        std::vector<BigUnsigned::Blk> allOnes(sizes[i][0], ~BigUnsigned::Blk(0));
+        BigUnsigned ones(&allOnes[0], sizes[i][0]);
+        BigUnsigned::nttThreshold = 1000000;
+        BigUnsigned expected = a * b, expectedOnes = ones * ones;
+        BigUnsigned::nttThreshold = 2;
+        EXPECT_TRUE(a * b == expected) << sizes[i][0] << "x" << sizes[i][1];
+        EXPECT_TRUE(ones * ones == expectedOnes) << sizes[i][0];
+    }
+    BigUnsigned::nttThreshold = saved;
+}
+
+TEST_F(BigUnsignedTest, Squaring) {
+    BigUnsigned zero, r;
+    r.square(zero);
+    EXPECT_TRUE(r.isZero());
+    BigUnsigned twelve(12);
+    r.square(twelve);
+    EXPECT_EQ(144, r.toInt());
+    twelve.square(twelve);
+    EXPECT_EQ(144, twelve.toInt());
+
+    /* Every tier must agree with the general product */
+    const BigUnsigned::Index savedK = BigUnsigned::karatsubaSquareThreshold;
+    const BigUnsigned::Index saved3 = BigUnsigned::toom3Threshold;
+    const BigUnsigned::Index saved4 = BigUnsigned::toom4Threshold;
+    const BigUnsigned::Index savedN = BigUnsigned::nttThreshold;
+    const BigUnsigned::Index tiers[][4] = {
+        {1000000, 1000000, 1000000, 1000000}, {2, 1000000, 1000000, 1000000},
+        {4, 7, 1000000, 1000000}, {4, 7, 20, 1000000}, {4, 7, 20, 2}
+    };
+    const BigUnsigned::Index sizes[] = {1, 2, 3, 8, 13, 29, 64, 150};
+    unsigned long long seed = 1181783497276652981ULL;
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        BigUnsigned a = randomBigUnsigned(sizes[i], seed);
+        BigUnsigned copy(a);
+        BigUnsigned expected = a * copy;
+        for (unsigned int t = 0; t < sizeof(tiers) / sizeof(tiers[0]); ++t) {
+            BigUnsigned::karatsubaSquareThreshold = tiers[t][0];
+            BigUnsigned::toom3Threshold = tiers[t][1];
+            BigUnsigned::toom4Threshold = tiers[t][2];
+            BigUnsigned::nttThreshold = tiers[t][3];
+            r.square(a);
+            EXPECT_TRUE(r == expected) << sizes[i] << " tier " << t;
+            EXPECT_TRUE(a * a == expected) << sizes[i] << " tier " << t;
+        }
+    }
+    BigUnsigned::karatsubaSquareThreshold = savedK;
+    BigUnsigned::toom3Threshold = saved3;
+    BigUnsigned::toom4Threshold = saved4;
+    BigUnsigned::nttThreshold = savedN;
+}
+
+TEST_F(BigUnsignedTest, Division) {
+    BigUnsigned a(100), q, seven(7), zero;
+    a.divideWithRemainder(seven, q);
+    EXPECT_EQ(14, q.toInt());
+    EXPECT_EQ(2, a.toInt());
+
+    /* Division by zero leaves the dividend as the remainder */
+    a = 100;
+    a.divideWithRemainder(zero, q);
+    EXPECT_TRUE(q.isZero());
+    EXPECT_EQ(100, a.toInt());
+    EXPECT_ANY_THROW(a / zero);
+    EXPECT_ANY_THROW(a % zero);
+
+    /* Quotient and remainder cannot share a variable */
+    EXPECT_ANY_THROW(a.divideWithRemainder(seven, a));
+    a.divideWithRemainder(a, q);
+    EXPECT_EQ(1, q.toInt());
+    EXPECT_TRUE(a.isZero());
+
+    EXPECT_EQ(14, (BigUnsigned(100) / seven).toInt());
+    EXPECT_EQ(2, (BigUnsigned(100) % seven).toInt());
+    a = 100;
+    a /= seven;
+    EXPECT_EQ(14, a.toInt());
+    a %= seven;
+    EXPECT_EQ(0, a.toInt());
+
+    /* (B^2 - 1) / (B - 1) = B + 1, which exercises the top == d1 estimate */
+    BigUnsigned::Blk ones[] = {~BigUnsigned::Blk(0), ~BigUnsigned::Blk(0)};
+    BigUnsigned::Blk bPlusOne[] = {1, 1};
+    BigUnsigned u(ones, 2), v(ones, 1);
+    u.divideWithRemainder(v, q);
+    EXPECT_TRUE(q == BigUnsigned(bPlusOne, 2));
+    EXPECT_TRUE(u.isZero());
+
+    /* q b + r = a with r < b, across divisor lengths and normalizing shifts */
+    const BigUnsigned::Index sizes[][2] = {
+        {1, 1}, {5, 1}, {2, 2}, {9, 2}, {7, 3}, {20, 19}, {40, 13}, {130, 64}
+    };
+    unsigned long long seed = 6364136223846793005ULL;
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+        for (unsigned int shift = 0; shift < 64; shift += 21) {
+            BigUnsigned x = randomBigUnsigned(sizes[i][0], seed);
+            std::vector<BigUnsigned::Blk> blocks(sizes[i][1]);
+            for (BigUnsigned::Index k = 0; k < sizes[i][1]; ++k)
+                blocks[k] = randomBigUnsigned(1, seed).toUnsignedLong();
+            blocks[sizes[i][1] - 1] = (blocks[sizes[i][1] - 1] >> shift) | 1;
+            BigUnsigned b(&blocks[0], sizes[i][1]);
+            BigUnsigned r(x);
+            r.divideWithRemainder(b, q);
+            EXPECT_TRUE(r < b) << sizes[i][0] << "/" << sizes[i][1];
+            EXPECT_TRUE(q * b + r == x) << sizes[i][0] << "/" << sizes[i][1];
+        }
+}
+
+TEST_F(BigUnsignedTest, DivisionBySmall) {
+    BigUnsigned a(100), zero;
+    EXPECT_EQ(2UL, a.remainderBySmall(7));
+    EXPECT_EQ(2UL, a.divideBySmall(7));
+    EXPECT_EQ(14, a.toInt());
+    EXPECT_EQ(0UL, zero.divideBySmall(7));
+    EXPECT_TRUE(zero.isZero());
+    EXPECT_ANY_THROW(a.divideBySmall(0));
+    EXPECT_ANY_THROW(a.remainderBySmall(0));
+
+    /* Must agree with long division, for divisors with and without the top
+     * bit set */
+    const BigUnsigned::Blk divisors[] = {
+        1, 2, 3, 10, 65537, 0xfffffffbUL, ~BigUnsigned::Blk(0) >> 1,
+        ~(~BigUnsigned::Blk(0) >> 1), ~BigUnsigned::Blk(0)
+    };
+    unsigned long long seed = 1442695040888963407ULL;
+    for (BigUnsigned::Index n = 1; n < 60; n += 7)
+        for (unsigned int i = 0; i < sizeof(divisors) / sizeof(divisors[0]); ++i) {
+            BigUnsigned x = randomBigUnsigned(n, seed), y(x), q, r(x);
+            BigUnsigned d(divisors[i]);
+            r.divideWithRemainder(d, q);
+            EXPECT_EQ(r.toUnsignedLong(), x.remainderBySmall(divisors[i]));
+            EXPECT_EQ(r.toUnsignedLong(), x.divideBySmall(divisors[i]));
+            EXPECT_TRUE(x == q) << n << " " << divisors[i];
+            EXPECT_TRUE(q * d + r == y);
+        }
+}
+
+TEST_F(BigUnsignedTest, BurnikelZieglerMatchesSchoolbook) {
+    const BigUnsigned::Index saved = BigUnsigned::burnikelZieglerThreshold;
+    const BigUnsigned::Index savedK = BigUnsigned::karatsubaThreshold;
+    /* Dividend and divisor lengths, including quotients several times longer
+     * than the divisor */
+    const BigUnsigned::Index sizes[][2] = {
+        {4, 2}, {7, 3}, {16, 8}, {33, 16}, {64, 17}, {100, 50}, {150, 31},
+        {257, 128}, {400, 100}
+    };
+    unsigned long long seed = 3935559000370003845ULL;
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        BigUnsigned a = randomBigUnsigned(sizes[i][0], seed);
+        BigUnsigned b = randomBigUnsigned(sizes[i][1], seed);
+        /* b^2 - 1 makes every partial quotient block B - 1 */
+        std::vector<BigUnsigned::Blk> allOnes(sizes[i][1], ~BigUnsigned::Blk(0));
+        BigUnsigned ones(&allOnes[0], sizes[i][1]);
+        BigUnsigned onesSquared = ones * ones - BigUnsigned(1);
+        BigUnsigned::burnikelZieglerThreshold = 1000000;
+        BigUnsigned q, r(a), expectedQ, expectedR(a);
+        expectedR.divideWithRemainder(b, expectedQ);
+        BigUnsigned q2, r2(onesSquared), expectedQ2, expectedR2(onesSquared);
+        expectedR2.divideWithRemainder(ones, expectedQ2);
+        /* Down to two blocks, with and without Karatsuba underneath */
+        const BigUnsigned::Index tiers[][2] = {{2, 1000000}, {5, 4}, {16, 4}};
+        for (unsigned int t = 0; t < sizeof(tiers) / sizeof(tiers[0]); ++t) {
+            BigUnsigned::burnikelZieglerThreshold = tiers[t][0];
+            BigUnsigned::karatsubaThreshold = tiers[t][1];
+            r = a;
+            r.divideWithRemainder(b, q);
+            EXPECT_TRUE(q == expectedQ) << sizes[i][0] << "/" << sizes[i][1];
+            EXPECT_TRUE(r == expectedR) << sizes[i][0] << "/" << sizes[i][1];
+            r2 = onesSquared;
+            r2.divideWithRemainder(ones, q2);
+            EXPECT_TRUE(q2 == expectedQ2) << sizes[i][1];
+            EXPECT_TRUE(r2 == expectedR2) << sizes[i][1];
+        }
+    }
+    BigUnsigned::burnikelZieglerThreshold = saved;
+    BigUnsigned::karatsubaThreshold = savedK;
+}
+
+TEST_F(BigUnsignedTest, NewtonMatchesBurnikelZiegler) {
+    const BigUnsigned::Index savedNewton = BigUnsigned::newtonThreshold;
+    const BigUnsigned::Index savedBz = BigUnsigned::burnikelZieglerThreshold;
+    const BigUnsigned::Index savedNtt = BigUnsigned::nttThreshold;
+    const BigUnsigned::Index sizes[][2] = {
+        {16, 8}, {17, 9}, {40, 12}, {64, 40}, {100, 50}, {200, 99},
+        {300, 64}, {333, 300}
+    };
+    /* Newton down to the smallest sizes, with the reciprocal's base case by
+     * Knuth or by Burnikel-Ziegler, and the cyclic products by folding or by
+     * the transform */
+    const BigUnsigned::Index tiers[][3] = {
+        {8, 1000000, 1000000}, {8, 6, 1000000}, {20, 1000000, 8}, {8, 6, 16}
+    };
+    unsigned long long seed = 7046029254386353131ULL;
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        BigUnsigned a = randomBigUnsigned(sizes[i][0], seed);
+        BigUnsigned b = randomBigUnsigned(sizes[i][1], seed);
+        std::vector<BigUnsigned::Blk> allOnes(sizes[i][1], ~BigUnsigned::Blk(0));
+        BigUnsigned ones(&allOnes[0], sizes[i][1]);
+        BigUnsigned onesSquared = ones * ones - BigUnsigned(1);
+        BigUnsigned::newtonThreshold = 1000000;
+        BigUnsigned q, r(a), expectedQ, expectedR(a);
+        expectedR.divideWithRemainder(b, expectedQ);
+        BigUnsigned q2, r2(onesSquared), expectedQ2, expectedR2(onesSquared);
+        expectedR2.divideWithRemainder(ones, expectedQ2);
+        for (unsigned int t = 0; t < sizeof(tiers) / sizeof(tiers[0]); ++t) {
+            BigUnsigned::newtonThreshold = tiers[t][0];
+            BigUnsigned::burnikelZieglerThreshold = tiers[t][1];
+            BigUnsigned::nttThreshold = tiers[t][2];
+            r = a;
+            r.divideWithRemainder(b, q);
+            EXPECT_TRUE(q == expectedQ) << sizes[i][0] << "/" << sizes[i][1];
+            EXPECT_TRUE(r == expectedR) << sizes[i][0] << "/" << sizes[i][1];
+            EXPECT_TRUE(a / b == expectedQ) << sizes[i][0] << "/" << sizes[i][1];
+            r2 = onesSquared;
+            r2.divideWithRemainder(ones, q2);
+            EXPECT_TRUE(q2 == expectedQ2) << sizes[i][1];
+            EXPECT_TRUE(r2 == expectedR2) << sizes[i][1];
+        }
+        BigUnsigned::burnikelZieglerThreshold = savedBz;
+        BigUnsigned::nttThreshold = savedNtt;
+    }
+    BigUnsigned::newtonThreshold = savedNewton;
+}
+
+TEST_F(BigUnsignedTest, BitShifts) {
+    BigUnsigned zero, one(1);
+    EXPECT_EQ(0U, zero.bitLength());
+    EXPECT_EQ(1U, one.bitLength());
+    EXPECT_EQ(7U, BigUnsigned(100).bitLength());
+    EXPECT_TRUE((zero << 100).isZero());
+    EXPECT_TRUE((one >> 1).isZero());
+    EXPECT_EQ(40, (BigUnsigned(5) << 3).toInt());
+    EXPECT_EQ(12, (BigUnsigned(100) >> 3).toInt());
+
+    // Must agree with multiplying and dividing by powers of two, across
+    // block boundaries and by whole blocks
+    unsigned long long seed = 6364136223846793005ULL;
+    const BigUnsigned::Index shifts[] = {0, 1, 5, 63, 64, 65, 128, 200};
+    for (BigUnsigned::Index n = 1; n < 20; n += 6)
+        for (unsigned int i = 0; i < sizeof(shifts) / sizeof(shifts[0]); ++i) {
+            BigUnsigned x = randomBigUnsigned(n, seed), p(1);
+            for (BigUnsigned::Index j = 0; j < shifts[i]; ++j)
+                p = p * BigUnsigned(2);
+            EXPECT_TRUE((x << shifts[i]) == x * p) << n << " " << shifts[i];
+            EXPECT_TRUE((x >> shifts[i]) == x / p) << n << " " << shifts[i];
+            EXPECT_EQ(x.bitLength() + shifts[i], (x << shifts[i]).bitLength());
+            BigUnsigned y(x);
+            y <<= shifts[i];
+            y >>= shifts[i];
+            EXPECT_TRUE(y == x);
+        }
+}
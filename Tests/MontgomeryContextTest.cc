@@ -0,0 +1,88 @@
+#include "gtest/include/gtest/gtest.h"
+#include "../MontgomeryContext.h"
+#include "TestUtil.h"
+#include <vector>
+
+/* x R mod n, computed the slow way */
+static BigUnsigned timesR(const BigUnsigned &x, const BigUnsigned &n,
+        BigUnsigned::Index k) {
+    std::vector<BigUnsigned::Blk> blocks(k + 1, 0);
+    blocks[k] = 1;
+    return x * BigUnsigned(&blocks[0], k + 1) % n;
+}
+
+TEST(MontgomeryContextTest, Construction) {
+    EXPECT_ANY_THROW(MontgomeryContext(BigUnsigned(0)));
+    EXPECT_ANY_THROW(MontgomeryContext(BigUnsigned(10)));
+
+    MontgomeryContext ctx(BigUnsigned(97));
+    EXPECT_EQ(97, ctx.getModulus().toInt());
+    EXPECT_EQ(1U, ctx.getLength());
+    EXPECT_TRUE(ctx.fromMontgomery(ctx.toMontgomery(BigUnsigned(1000))) == BigUnsigned(1000 % 97));
+    EXPECT_TRUE(BigUnsigned(ctx.getOne(), 1) == timesR(BigUnsigned(1), BigUnsigned(97), 1));
+
+    /* Everything is 0 modulo 1 */
+    MontgomeryContext unit(BigUnsigned(1));
+    EXPECT_TRUE(unit.toMontgomery(BigUnsigned(5)).isZero());
+}
+
+TEST(MontgomeryContextTest, MatchesDivision) {
+    const BigUnsigned::Index sizes[] = {1, 2, 3, 8, 16, 32, 40};
+    unsigned long long seed = 5573589319906701683ULL;
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        BigUnsigned::Index k = sizes[i];
+        std::vector<BigUnsigned::Blk> blocks(k, ~BigUnsigned::Blk(0));
+        BigUnsigned allOnes(&blocks[0], k);
+        blocks.assign(k, 0);
+        blocks[0] = 1;
+        blocks[k - 1] |= 1;
+        BigUnsigned small(&blocks[0], k);
+        BigUnsigned n = randomBigUnsigned(k, seed);
+        if (n.remainderBySmall(2) == 0)
+            n = n + BigUnsigned(1);
+        const BigUnsigned moduli[] = {n, allOnes, small};
+        for (unsigned int j = 0; j < 3; ++j) {
+            const BigUnsigned &m = moduli[j];
+            MontgomeryContext ctx(m);
+            EXPECT_TRUE(BigUnsigned(ctx.getOne(), k) == timesR(BigUnsigned(1), m, k));
+
+            BigUnsigned a = randomBigUnsigned(k + 1, seed);
+            BigUnsigned b = randomBigUnsigned(k, seed) % m;
+            BigUnsigned largest = m - BigUnsigned(1);
+            std::vector<BigUnsigned::Blk> am(k), bm(k), lm(k), r(k);
+            std::vector<BigUnsigned::Blk> ws(ctx.getScratchSize());
+            ctx.toMontgomery(&am[0], a);
+            ctx.toMontgomery(&bm[0], b);
+            ctx.toMontgomery(&lm[0], largest);
+            EXPECT_TRUE(BigUnsigned(&am[0], k) == timesR(a, m, k)) << k << " " << j;
+            /* Several chunks of k blocks, and the subtraction both ways */
+            BigUnsigned x = randomBigUnsigned(3 * k + 1, seed);
+            std::vector<BigUnsigned::Blk> xm(k);
+            ctx.toMontgomery(&xm[0], x);
+            EXPECT_TRUE(BigUnsigned(&xm[0], k) == timesR(x, m, k)) << k << " " << j;
+            BigUnsigned xr = x % m, difference;
+            ctx.subMod(&r[0], &bm[0], &xm[0]);
+            ctx.fromMontgomery(difference, &r[0]);
+            EXPECT_TRUE(difference == (b + m - xr) % m) << k << " " << j;
+            ctx.subMod(&r[0], &xm[0], &bm[0]);
+            ctx.fromMontgomery(difference, &r[0]);
+            EXPECT_TRUE(difference == (xr + m - b) % m) << k << " " << j;
+
+            BigUnsigned result;
+            ctx.montMul(&r[0], &am[0], &bm[0]);
+            ctx.fromMontgomery(result, &r[0]);
+            EXPECT_TRUE(result == a * b % m) << k << " " << j;
+            ctx.montMul(&r[0], &lm[0], &lm[0]);
+            ctx.fromMontgomery(result, &r[0]);
+            EXPECT_TRUE(result == largest * largest % m) << k << " " << j;
+
+            ctx.montSqr(&r[0], &am[0], &ws[0]);
+            ctx.fromMontgomery(result, &r[0]);
+            EXPECT_TRUE(result == a * a % m) << k << " " << j;
+            /* In place */
+            ctx.montSqr(&lm[0], &lm[0], &ws[0]);
+            ctx.fromMontgomery(result, &lm[0]);
+            EXPECT_TRUE(result == largest * largest % m) << k << " " << j;
+        }
+    }
+}
@@ -0,0 +1,159 @@
+#include "gtest/include/gtest/gtest.h"
+#include "../RsaKeyPool.h"
+#include "../BigUnsignedAlgorithms.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char *const poolFile = "RsaKeyPoolTest.pool";
+
+static BigUnsigned fromHex(const std::string &s) {
+    BigUnsigned x;
+    for (unsigned int i = 0; i < s.size(); ++i) {
+        x <<= 4;
+        x += BigUnsigned((unsigned long)(s[i] <= '9' ? s[i] - '0'
+                    : s[i] - 'a' + 10));
+    }
+    return x;
+}
+
+/* Whether the key decrypts what e = 65537 encrypts */
+static bool works(const RsaPrivateKey &key) {
+    BigUnsigned m(1234567);
+    return key.decrypt(modPow(m, BigUnsigned(65537), key.getModulus())) == m;
+}
+
+TEST(RsaKeyPoolTest, PopsAndRefills) {
+    RsaKeyPool pool(512, 2, 4, "", 2);
+    pool.waitUntilFull();
+    EXPECT_EQ(4u, pool.keysReady());
+    std::vector<BigUnsigned> moduli;
+    for (int i = 0; i < 3; ++i) {
+        RsaPrivateKey key = pool.popKey();
+        EXPECT_EQ(512u, key.getModulus().bitLength());
+        EXPECT_TRUE(works(key));
+        for (unsigned int j = 0; j < moduli.size(); ++j)
+            EXPECT_TRUE(moduli[j] != key.getModulus());
+        moduli.push_back(key.getModulus());
+    }
+    // Below the low watermark, so back up to the high one
+    pool.waitUntilFull();
+    EXPECT_EQ(4u, pool.keysReady());
+    EXPECT_ANY_THROW(pool.popSafePrime());
+
+    EXPECT_ANY_THROW(RsaKeyPool(512, 3, 2));
+    EXPECT_ANY_THROW(RsaKeyPool(512, 0, 0));
+    EXPECT_ANY_THROW(RsaKeyPool(512, 1, 2, "", 1, 0, 1));
+    EXPECT_ANY_THROW(RsaKeyPool(512, 1, 2, "", 1, 2));
+}
+
+TEST(RsaKeyPoolTest, WaitsFromBetweenWatermarks) {
+    // One pop leaves the pool above the low watermark, where the threads
+    // would rest of their own accord
+    RsaKeyPool pool(256, 1, 3, "", 1, 64);
+    pool.waitUntilFull();
+    pool.popKey();
+    pool.popSafePrime();
+    EXPECT_EQ(2u, pool.keysReady());
+    EXPECT_EQ(2u, pool.safePrimesReady());
+    pool.waitUntilFull();
+    EXPECT_EQ(3u, pool.keysReady());
+    EXPECT_EQ(3u, pool.safePrimesReady());
+}
+
+TEST(RsaKeyPoolTest, SafePrimes) {
+    RsaKeyPool pool(256, 1, 2, "", 1, 96);
+    pool.waitUntilFull();
+    for (int i = 0; i < 3; ++i) {
+        BigUnsigned p = pool.popSafePrime();
+        EXPECT_EQ(96u, p.bitLength());
+        EXPECT_TRUE(isProbablePrime(p) && isProbablePrime(p >> 1));
+    }
+}
+
+TEST(RsaKeyPoolTest, Persists) {
+    std::remove(poolFile);
+    BigUnsigned taken[3];
+    {
+        RsaKeyPool pool(512, 1, 4, poolFile, 2, 64);
+        pool.waitUntilFull();
+        for (int i = 0; i < 3; ++i)
+            taken[i] = pool.popKey().getModulus();
+        pool.popSafePrime();
+    }
+    // The file holds private keys, so only its owner may read it
+    struct stat status;
+    ASSERT_EQ(0, stat(poolFile, &status));
+    EXPECT_EQ(0600u, status.st_mode & 0777u);
+    {
+        // What was left comes back, and nothing taken does
+        RsaKeyPool pool(512, 1, 4, poolFile, 1, 64);
+        EXPECT_GE(pool.keysReady(), 1u);
+        EXPECT_GE(pool.safePrimesReady(), 1u);
+        pool.waitUntilFull();
+        for (int i = 0; i < 3; ++i) {
+            RsaPrivateKey key = pool.popKey();
+            EXPECT_TRUE(works(key));
+            for (int j = 0; j < 3; ++j)
+                EXPECT_TRUE(key.getModulus() != taken[j]);
+        }
+    }
+    {
+        // A process that dies just after handing out a key leaves the file
+        // with the key and its taken line; lines that do not parse are
+        // skipped
+        std::ifstream in(poolFile);
+        std::string line, word, id, p, q;
+        std::getline(in, line);
+        std::getline(in, line);
+        std::istringstream words(line);
+        words >> word >> id >> p >> q;
+        ASSERT_EQ("key", word);
+        in.close();
+        taken[0] = fromHex(p) * fromHex(q);
+        std::ofstream out(poolFile, std::ios::app);
+        out << "taken " << id << "\ngarbage line\nkey 99999 12 34\n";
+    }
+    {
+        RsaKeyPool pool(512, 1, 4, poolFile, 1, 64);
+        pool.waitUntilFull();
+        for (int i = 0; i < 4; ++i)
+            EXPECT_TRUE(pool.popKey().getModulus() != taken[0]);
+    }
+    {
+        // A pool with other settings starts afresh
+        RsaKeyPool pool(576, 1, 1, poolFile);
+        pool.waitUntilFull();
+        EXPECT_EQ(576u, pool.popKey().getModulus().bitLength());
+    }
+    std::remove(poolFile);
+}
+
+TEST(RsaKeyPoolTest, KeepsKeysItCannotRecord) {
+    const char *const directory = "RsaKeyPoolTest.dir";
+    std::string path = std::string(directory) + "/pool";
+    std::remove(path.c_str());
+    rmdir(directory);
+    ASSERT_EQ(0, mkdir(directory, 0700));
+    RsaKeyPool pool(512, 1, 2, path, 1, 64);
+    pool.waitUntilFull();
+    // With the directory gone, nothing can be marked as taken, so nothing
+    // is handed out. The rewrite after the last key may still be under way.
+    std::string temporary = path + ".new";
+    for (int i = 0; i < 100; ++i) {
+        std::remove(path.c_str());
+        std::remove(temporary.c_str());
+        if (rmdir(directory) == 0)
+            break;
+        usleep(10000);
+    }
+    ASSERT_NE(0, access(directory, F_OK));
+    EXPECT_ANY_THROW(pool.popKey());
+    EXPECT_ANY_THROW(pool.popSafePrime());
+    EXPECT_EQ(2u, pool.keysReady());
+    EXPECT_EQ(2u, pool.safePrimesReady());
+}
@@ -0,0 +1,117 @@
+#include "gtest/include/gtest/gtest.h"
+#include "../RsaPrivateKey.h"
+#include "../BigUnsignedAlgorithms.h"
+#include "TestUtil.h"
+#include <vector>
+
+/* 2^bits - 1 */
+static BigUnsigned mersenne(unsigned int bits) {
+    return (BigUnsigned(1) << bits) - BigUnsigned(1);
+}
+
+TEST(RsaPrivateKeyTest, TextbookKey) {
+    // p = 61, q = 53, e = 17, d = 2753
+    RsaPrivateKey key(BigUnsigned(61), BigUnsigned(53), BigUnsigned(2753));
+    EXPECT_EQ(3233, key.getModulus().toInt());
+    EXPECT_EQ(53, key.getDP().toInt());
+    EXPECT_EQ(49, key.getDQ().toInt());
+    EXPECT_EQ(38, key.getQInv().toInt());
+    EXPECT_EQ(65, key.decrypt(BigUnsigned(2790)).toInt());
+    EXPECT_TRUE(key.sign(BigUnsigned(65))
+            == modPow(BigUnsigned(65), BigUnsigned(2753), BigUnsigned(3233)));
+    EXPECT_ANY_THROW(key.decrypt(BigUnsigned(3233)));
+
+    RsaPrivateKey same(BigUnsigned(61), BigUnsigned(53), BigUnsigned(53),
+            BigUnsigned(49), BigUnsigned(38));
+    EXPECT_EQ(65, same.decrypt(BigUnsigned(2790)).toInt());
+    EXPECT_ANY_THROW(RsaPrivateKey(BigUnsigned(61), BigUnsigned(53),
+            BigUnsigned(53), BigUnsigned(49), BigUnsigned(61)));
+    EXPECT_ANY_THROW(RsaPrivateKey(BigUnsigned(62), BigUnsigned(53),
+            BigUnsigned(2753)));
+}
+
+TEST(RsaPrivateKeyTest, MatchesModPow) {
+    // Any exponent works with the CRT, as long as the input is prime to n
+    const unsigned int primes[][2] = {{127, 89}, {521, 607}, {607, 521}};
+    unsigned long long seed = 3141592653589793238ULL;
+    for (unsigned int i = 0; i < 3; ++i) {
+        BigUnsigned p = mersenne(primes[i][0]), q = mersenne(primes[i][1]);
+        BigUnsigned d = randomBigUnsigned(18, seed);
+        RsaPrivateKey key(p, q, d);
+        // A copy keeps working
+        RsaPrivateKey copy = key;
+        for (int j = 0; j < 3; ++j) {
+            BigUnsigned c = randomBigUnsigned(18, seed) % key.getModulus();
+            EXPECT_TRUE(copy.decrypt(c) == modPow(c, d, key.getModulus())) << i;
+        }
+    }
+}
+
+TEST(RsaPrivateKeyTest, MultiPrime) {
+    // Four Mersenne primes, loaded by components and from the primes
+    const unsigned int exponents[] = {521, 607, 127, 89};
+    std::vector<BigUnsigned> primes;
+    for (unsigned int i = 0; i < 4; ++i)
+        primes.push_back(mersenne(exponents[i]));
+    unsigned long long seed = 6364136223846793005ULL;
+    BigUnsigned d = randomBigUnsigned(22, seed);
+    RsaPrivateKey key(primes, d);
+    EXPECT_EQ(4U, key.getPrimeCount());
+    EXPECT_TRUE(key.getModulus() == primes[0] * primes[1] * primes[2] * primes[3]);
+    std::vector<RsaPrivateKey::OtherPrime> others = key.getOtherPrimes();
+    ASSERT_EQ(2U, others.size());
+    EXPECT_TRUE(others[1].prime == primes[3]);
+    // t_4 (p q r_3) = 1 mod r_4
+    EXPECT_TRUE(others[1].coefficient * primes[0] * primes[1] * primes[2]
+            % primes[3] == BigUnsigned(1));
+
+    RsaPrivateKey loaded(key.getP(), key.getQ(), key.getDP(), key.getDQ(),
+            key.getQInv(), others);
+    for (int j = 0; j < 3; ++j) {
+        BigUnsigned c = randomBigUnsigned(22, seed) % key.getModulus();
+        BigUnsigned m = modPow(c, d, key.getModulus());
+        EXPECT_TRUE(key.decrypt(c) == m);
+        EXPECT_TRUE(loaded.decrypt(c) == m);
+    }
+    primes.resize(1);
+    EXPECT_ANY_THROW(RsaPrivateKey(primes, d));
+}
+
+TEST(RsaPrivateKeyTest, Generate) {
+    const unsigned int counts[] = {2, 3, 4};
+    for (unsigned int i = 0; i < 3; ++i) {
+        RsaPrivateKey key = RsaPrivateKey::generate(512, counts[i]);
+        EXPECT_EQ(counts[i], key.getPrimeCount());
+        BigUnsigned n = key.getModulus(), top = BigUnsigned(1) << 511;
+        EXPECT_TRUE(n >= top && n < (top << 1));
+        // Encrypting with e = 65537 and decrypting gives the message back
+        BigUnsigned m(1234567);
+        EXPECT_TRUE(key.decrypt(modPow(m, BigUnsigned(65537), n)) == m) << counts[i];
+    }
+    EXPECT_ANY_THROW(RsaPrivateKey::generate(512, 1));
+    EXPECT_ANY_THROW(RsaPrivateKey::generate(512, 2, 4));
+}
+
+TEST(RsaPrivateKeyTest, GenerateThreaded) {
+    RsaPrivateKey key = RsaPrivateKey::generate(768, 2, 65537, 4);
+    EXPECT_EQ(768u, key.getModulus().bitLength());
+    BigUnsigned m(7654321);
+    EXPECT_TRUE(key.decrypt(modPow(m, BigUnsigned(65537), key.getModulus()))
+            == m);
+
+    double rate = 0;
+    std::vector<RsaPrivateKey> keys = RsaPrivateKey::generateMany(5, 512, 2,
+            3, 3, &rate);
+    ASSERT_EQ(5u, keys.size());
+    EXPECT_GT(rate, 0);
+    for (unsigned int i = 0; i < keys.size(); ++i) {
+        const BigUnsigned &n = keys[i].getModulus();
+        EXPECT_EQ(512u, n.bitLength());
+        EXPECT_TRUE(keys[i].decrypt(modPow(m, BigUnsigned(3), n)) == m) << i;
+        for (unsigned int j = 0; j < i; ++j)
+            EXPECT_TRUE(keys[j].getModulus() != n) << i;
+    }
+    EXPECT_EQ(0u, RsaPrivateKey::generateMany(0, 512).size());
+    EXPECT_ANY_THROW(RsaPrivateKey::generateMany(2, 512, 1));
+    EXPECT_ANY_THROW(RsaPrivateKey::generateMany(2, 512, 2, 4));
+}
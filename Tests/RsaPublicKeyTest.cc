@@ -0,0 +1,28 @@
+#include "gtest/include/gtest/gtest.h"
+#include "../RsaPublicKey.h"
+#include "../RsaPrivateKey.h"
+#include "../BigUnsignedAlgorithms.h"
+
+TEST(RsaPublicKeyTest, TextbookKey) {
+    // p = 61, q = 53, e = 17, d = 2753
+    RsaPublicKey key(BigUnsigned(3233), BigUnsigned(17));
+    EXPECT_EQ(2790, key.encrypt(BigUnsigned(65)).toInt());
+    EXPECT_EQ(17, key.getExponent().toInt());
+    EXPECT_ANY_THROW(key.encrypt(BigUnsigned(3233)));
+    EXPECT_ANY_THROW(RsaPublicKey(BigUnsigned(3233), BigUnsigned(1)));
+    EXPECT_ANY_THROW(RsaPublicKey(BigUnsigned(3233), BigUnsigned(16)));
+    EXPECT_ANY_THROW(RsaPublicKey(BigUnsigned(3232), BigUnsigned(17)));
+}
+
+TEST(RsaPublicKeyTest, RoundTrip) {
+    const unsigned long exponents[] = {3, 17, 65537, 0x100000001UL};
+    for (unsigned int i = 0; i < 4; ++i) {
+        RsaPrivateKey priv = RsaPrivateKey::generate(512, 2, exponents[i]);
+        RsaPublicKey pub(priv.getModulus(), BigUnsigned(exponents[i]));
+        BigUnsigned m = priv.getModulus() - BigUnsigned(99);
+        BigUnsigned c = pub.encrypt(m);
+        EXPECT_TRUE(c == modPowConstantTime(m, pub.getExponent(), pub.getModulus()));
+        EXPECT_TRUE(priv.decrypt(c) == m);
+        EXPECT_TRUE(pub.verify(priv.sign(m)) == m);
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef TESTUTIL_H
+#define TESTUTIL_H
+
+#include "../BigUnsigned.h"
+#include <vector>
+
+/* Deterministic pseudo-random BigUnsigned of n blocks (xorshift64*) */
+inline BigUnsigned randomBigUnsigned(BigUnsigned::Index n, unsigned long long &seed) {
+    std::vector<BigUnsigned::Blk> blocks(n);
+    for (BigUnsigned::Index i = 0; i < n; ++i) {
+        seed ^= seed >> 12;
+        seed ^= seed << 25;
+        seed ^= seed >> 27;
+        blocks[i] = BigUnsigned::Blk(seed * 2685821657736338717ULL);
+    }
+    return BigUnsigned(&blocks[0], n);
+}
+
+#endif